@@ -29,6 +29,7 @@ cEvent::cEvent( const eEventType& pType ) {
 	mButtonRaw = 0;
 	mButtonCount = 0;
 	mJoyAxis = 0;
+	mTimestamp = 0;
 }
 
 cEvent::~cEvent() {
@@ -49,6 +49,8 @@ class cEvent {
 		int					mJoyAxis;
 		cPosition			mPosition;
 
+		unsigned int		mTimestamp;		// Milliseconds (SDL_GetTicks) when the event was queued
+
 	public:
 							cEvent( const eEventType& pType = eEvent_None );
 		virtual				~cEvent();
@@ -0,0 +1,94 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Collision Broadphase
+ *  ------------------------------------------
+ */
+
+#include "stdafx.h"
+#include "creep.h"
+#include "broadphase.h"
+
+cBroadphase::cBroadphase() {
+
+	memset( mStamp, 0, sizeof( mStamp ) );
+	mStampCurrent = 0;
+	mDirty = true;
+}
+
+// Place each object into every cell its bounding box overlaps
+void cBroadphase::build( const sCreepAnim *pObjects, byte pCount ) {
+
+	for( size_t cell = 0; cell < BROADPHASE_CELLS * BROADPHASE_CELLS; ++cell )
+		mCells[cell].clear();
+
+	for( byte ObjectNumber = 0; ObjectNumber < pCount; ++ObjectNumber ) {
+		const sCreepAnim *object = &pObjects[ObjectNumber];
+
+		// The right/bottom edges can run past 0xFF, the same as the original compare
+		byte cellLeft = cellGet( object->mX );
+		byte cellRight = cellGet( object->mX + object->mWidth );
+		byte cellTop = cellGet( object->mY );
+		byte cellBottom = cellGet( object->mY + object->mHeight );
+
+		for( byte cellY = cellTop; cellY <= cellBottom; ++cellY )
+			for( byte cellX = cellLeft; cellX <= cellRight; ++cellX )
+				mCells[ (cellY * BROADPHASE_CELLS) + cellX ].push_back( ObjectNumber );
+	}
+
+	mDirty = false;
+}
+
+// Collect each object overlapping the cells of the box, in object number order
+void cBroadphase::query( size_t pLeft, size_t pTop, size_t pRight, size_t pBottom, vector< byte > &pResult ) {
+
+	pResult.clear();
+
+	// Stamp wrapped, start again
+	if( ++mStampCurrent == 0 ) {
+		memset( mStamp, 0, sizeof( mStamp ) );
+		mStampCurrent = 1;
+	}
+
+	byte cellLeft = cellGet( pLeft );
+	byte cellRight = cellGet( pRight );
+	byte cellTop = cellGet( pTop );
+	byte cellBottom = cellGet( pBottom );
+
+	for( byte cellY = cellTop; cellY <= cellBottom; ++cellY ) {
+		for( byte cellX = cellLeft; cellX <= cellRight; ++cellX ) {
+			vector< byte > *cell = &mCells[ (cellY * BROADPHASE_CELLS) + cellX ];
+
+			for( vector< byte >::iterator objectIT = cell->begin(); objectIT != cell->end(); ++objectIT ) {
+
+				// Objects spanning several cells are only returned once
+				if( mStamp[ *objectIT ] == mStampCurrent )
+					continue;
+
+				mStamp[ *objectIT ] = mStampCurrent;
+				pResult.push_back( *objectIT );
+			}
+		}
+	}
+
+	// Handlers must run in the same order as the full table walk
+	sort( pResult.begin(), pResult.end() );
+}
@@ -0,0 +1,56 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Collision Broadphase
+ *  ------------------------------------------
+ */
+
+struct sCreepAnim;
+
+// Cell size is 16x16 room pixels, covering the full byte coordinate range
+#define BROADPHASE_CELL_SHIFT	4
+#define BROADPHASE_CELLS		(0x100 >> BROADPHASE_CELL_SHIFT)
+
+// Uniform grid of the room objects, used by large-room mode to find the
+// objects a sprite may be touching without walking the entire object table
+class cBroadphase {
+private:
+	vector< byte >		 mCells[ BROADPHASE_CELLS * BROADPHASE_CELLS ];	// Object numbers in each cell
+	dword				 mStamp[ 0x100 ];								// Last query each object was returned by
+	dword				 mStampCurrent;
+	bool				 mDirty;
+
+	inline byte			 cellGet( size_t pPos ) {						// Cell column/row for a coordinate
+		if( pPos > 0xFF )
+			pPos = 0xFF;
+
+		return (byte) (pPos >> BROADPHASE_CELL_SHIFT);
+	}
+
+public:
+						 cBroadphase();
+
+	void				 build( const sCreepAnim *pObjects, byte pCount );	// Rebuild the grid from the object table
+	void				 query( size_t pLeft, size_t pTop, size_t pRight, size_t pBottom, vector< byte > &pResult );
+
+	inline void			 invalidate()	{ mDirty = true; }				// An object moved, or the table changed
+	inline bool			 dirtyGet()		{ return mDirty; }
+};
@@ -388,6 +388,7 @@ void cBuilder::cursorUpdate() {
 
 void cBuilder::castlePrepare( ) {
 	save( false );
+	gameSaveErrorShow();
 
 	// Final Room?
 	if( (char) mCurrentRoom->mNumber == -1) {
@@ -433,6 +434,8 @@ void cBuilder::mapRoomsDraw( size_t pArrowRoom ) {
 	map< int, cRoom *>::iterator	roomIT;
 	map< int, cRoom *>				*rooms = mCastle->roomsGet();
 
+	bool							 arrow = false;
+
 	screenClear();
 
 	// Loop through the data for each room, marking it as visible
@@ -446,13 +449,16 @@ void cBuilder::mapRoomsDraw( size_t pArrowRoom ) {
 
 		mMemory[ mRoomPtr ] |= MAP_ROOM_VISIBLE;
 
-		// Draw the room
-		mapRoomDraw();
+		if( roomIT->second->mNumber == pArrowRoom )
+			arrow = true;
+	}
+
+	// Draw the rooms, once they are all visible
+	mapRoomDraw();
 
-		if( roomIT->second->mNumber == pArrowRoom ) {
-			roomPtrSet( roomIT->second->mNumber );
-			mapArrowDraw( 0 );
-		}
+	if( arrow ) {
+		roomPtrSet( (byte) pArrowRoom );
+		mapArrowDraw( 0 );
 	}
 
 	// Set the sprite color to white
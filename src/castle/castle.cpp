@@ -144,6 +144,85 @@ void cCastle::castleLoad( cBuilder *pBuilder ) {
 	}
 }	
 
+// Does the object list at 'pAddress' lie in the castle, and start with a known object
+static bool castleObjectsTest( const byte *pCastle, size_t pSize, word pAddress ) {
+
+	if( pAddress < 0x7800 || (size_t) (pAddress - 0x7800) + 2 > pSize )
+		return false;
+
+	switch( readLEWord( pCastle + (pAddress - 0x7800) ) ) {
+		case eObjectNone:
+		case eObjectDoor:
+		case eObjectWalkway:
+		case eObjectSlidingPole:
+		case eObjectLadder:
+		case eObjectDoorBell:
+		case eObjectLightning:
+		case eObjectForcefield:
+		case eObjectMummy:
+		case eObjectKey:
+		case eObjectLock:
+		case eObjectRayGun:
+		case eObjectTeleport:
+		case eObjectTrapDoor:
+		case eObjectConveyor:
+		case eObjectFrankenstein:
+		case eObjectText:
+		case eObjectImage:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+/**
+ * Check the layout castleLoad expects, without loading the castle into game memory
+ */
+bool cCastle::castleTest( const byte *pBuffer, size_t pBufferSize, string &pError ) {
+	stringstream error;
+
+	// Skip the load address, the castle is loaded at 0x7800 and copied to 0x9800
+	if( pBufferSize < 0x102 || pBufferSize - 2 > 0x6800 ) {
+		pError = "castle size is out of range";
+		return false;
+	}
+
+	const byte *castle = pBuffer + 2;
+	size_t		size = pBufferSize - 2;
+
+	if( castle[2] != 0x80 ) {
+		pError = "castle marker missing";
+		return false;
+	}
+
+	// Room directory, eight bytes per room
+	size_t pos = 0x100, room = 0;
+
+	for( ; pos < size && castle[pos] != 0xFF && castle[pos] != 0x40; pos += 8, ++room ) {
+
+		if( pos + 8 > size || !castleObjectsTest( castle, size, readLEWord( castle + pos + 6 ) ) ) {
+			error << "room " << room << " has a bad object list";
+			pError = error.str();
+			return false;
+		}
+	}
+
+	if( pos >= size ) {
+		pError = "room directory is not terminated";
+		return false;
+	}
+
+	word final = readLEWord( castle + 0x5F );
+
+	if( final && !castleObjectsTest( castle, size, final ) ) {
+		pError = "final screen has a bad object list";
+		return false;
+	}
+
+	return true;
+}
+
 /**
  * Save a castle to memory
  */
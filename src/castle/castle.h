@@ -51,6 +51,7 @@ public:
 						~cCastle();
 
 	void				 castleLoad( cBuilder *pBuilder );
+	static bool			 castleTest( const byte *pBuffer, size_t pBufferSize, string &pError );	// Check a castle file can be loaded
 	void				 castleSave( byte *pTarget );
 	map< int, cRoom *>	*roomsGet()			{ return &mRooms; }
 	
@@ -0,0 +1,256 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Castle Index Cache
+ *  ------------------------------------------
+ */
+
+#include "stdafx.h"
+#include "castleIndex.h"
+
+// Append values to the index buffer, little-endian
+static void indexByteWrite( vector< byte > &pBuffer, byte pValue ) {
+	pBuffer.push_back( pValue );
+}
+
+static void indexWordWrite( vector< byte > &pBuffer, word pValue ) {
+	pBuffer.push_back( pValue & 0xFF );
+	pBuffer.push_back( pValue >> 8 );
+}
+
+static void indexDwordWrite( vector< byte > &pBuffer, dword pValue ) {
+	indexWordWrite( pBuffer, pValue & 0xFFFF );
+	indexWordWrite( pBuffer, pValue >> 16 );
+}
+
+static void indexStringWrite( vector< byte > &pBuffer, const string &pValue ) {
+	indexByteWrite( pBuffer, (byte) pValue.size() );
+	pBuffer.insert( pBuffer.end(), pValue.begin(), pValue.end() );
+}
+
+// Read values back out of the index, failing once the buffer runs out
+struct sIndexReader {
+	const byte	*mBuffer;
+	size_t		 mSize, mPos;
+	bool		 mFailed;
+
+	sIndexReader( const byte *pBuffer, size_t pSize ) {
+		mBuffer = pBuffer;
+		mSize = pSize;
+		mPos = 0;
+		mFailed = false;
+	}
+
+	bool need( size_t pBytes ) {
+		if( mFailed || mPos + pBytes > mSize )
+			mFailed = true;
+
+		return !mFailed;
+	}
+
+	byte byteRead() {
+		if( !need( 1 ) )
+			return 0;
+
+		return mBuffer[ mPos++ ];
+	}
+
+	word wordRead() {
+		if( !need( 2 ) )
+			return 0;
+
+		word value = mBuffer[ mPos ] | (mBuffer[ mPos + 1 ] << 8);
+		mPos += 2;
+		return value;
+	}
+
+	dword dwordRead() {
+		dword value = wordRead();
+
+		return value | (wordRead() << 16);
+	}
+
+	string stringRead() {
+		size_t length = byteRead();
+
+		if( !need( length ) )
+			return "";
+
+		string value( (const char*) mBuffer + mPos, length );
+		mPos += length;
+		return value;
+	}
+};
+
+cCastleIndex::cCastleIndex() {
+
+	mChanged = false;
+}
+
+string cCastleIndex::keyGet( eCastleSource pSource, string pFilename ) {
+	stringstream key;
+
+	key << (int) pSource << ":" << pFilename;
+	return key.str();
+}
+
+bool cCastleIndex::load() {
+	size_t	 size = 0;
+	byte	*buffer = local_FileRead( CASTLE_INDEX_FILE, CASTLE_INDEX_PATH, size, false );
+
+	mSources.clear();
+	mChanged = false;
+
+	if( !buffer )
+		return false;
+
+	sIndexReader reader( buffer, size );
+
+	// Written by this version?
+	if( !reader.need( 4 ) || memcmp( buffer, "CRPI", 4 ) ) {
+		delete buffer;
+		return false;
+	}
+
+	reader.mPos = 4;
+	if( reader.dwordRead() != CASTLE_INDEX_VERSION ) {
+		delete buffer;
+		return false;
+	}
+
+	dword sources = reader.dwordRead();
+
+	for( dword i = 0; i < sources && !reader.mFailed; ++i ) {
+		sCastleIndexSource source;
+
+		source.mSource = (eCastleSource) reader.byteRead();
+		source.mFilename = reader.stringRead();
+		source.mSize = reader.dwordRead();
+		source.mTime = reader.dwordRead();
+
+		word castles = reader.wordRead();
+
+		for( word j = 0; j < castles && !reader.mFailed; ++j ) {
+			sCastleIndexCastle castle;
+
+			castle.mName = reader.stringRead();
+			castle.mTrack = reader.byteRead();
+			castle.mSector = reader.byteRead();
+			castle.mSize = reader.dwordRead();
+
+			source.mCastles.push_back( castle );
+		}
+
+		if( !reader.mFailed )
+			mSources[ keyGet( source.mSource, source.mFilename ) ] = source;
+	}
+
+	delete buffer;
+
+	// A damaged index is thrown away, and rebuilt by the next scan
+	if( reader.mFailed ) {
+		mSources.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool cCastleIndex::save() {
+	map< string, sCastleIndexSource >::iterator sourceIT;
+	vector< sCastleIndexCastle >::iterator		castleIT;
+	vector< byte >								buffer;
+
+	// Drop anything not found by this scan
+	for( sourceIT = mSources.begin(); sourceIT != mSources.end(); ) {
+
+		if( !sourceIT->second.mSeen ) {
+			mSources.erase( sourceIT++ );
+			mChanged = true;
+		} else
+			++sourceIT;
+	}
+
+	if( !mChanged )
+		return true;
+
+	buffer.insert( buffer.end(), "CRPI", "CRPI" + 4 );
+	indexDwordWrite( buffer, CASTLE_INDEX_VERSION );
+	indexDwordWrite( buffer, (dword) mSources.size() );
+
+	for( sourceIT = mSources.begin(); sourceIT != mSources.end(); ++sourceIT ) {
+		sCastleIndexSource *source = &sourceIT->second;
+
+		indexByteWrite( buffer, (byte) source->mSource );
+		indexStringWrite( buffer, source->mFilename );
+		indexDwordWrite( buffer, source->mSize );
+		indexDwordWrite( buffer, source->mTime );
+		indexWordWrite( buffer, (word) source->mCastles.size() );
+
+		for( castleIT = source->mCastles.begin(); castleIT != source->mCastles.end(); ++castleIT ) {
+			indexStringWrite( buffer, castleIT->mName );
+			indexByteWrite( buffer, castleIT->mTrack );
+			indexByteWrite( buffer, castleIT->mSector );
+			indexDwordWrite( buffer, castleIT->mSize );
+		}
+	}
+
+	local_DirectoryCreate( CASTLE_INDEX_PATH, false );
+
+	if( !local_FileSave( CASTLE_INDEX_FILE, CASTLE_INDEX_PATH, false, &buffer[0], buffer.size() ) ) {
+		cout << "Castle index: unable to write " << CASTLE_INDEX_FILE << endl;
+		return false;
+	}
+
+	mChanged = false;
+	return true;
+}
+
+// Find a source, if it has not changed since it was indexed
+sCastleIndexSource *cCastleIndex::find( eCastleSource pSource, string pFilename, dword pSize, dword pTime ) {
+	map< string, sCastleIndexSource >::iterator sourceIT = mSources.find( keyGet( pSource, pFilename ) );
+
+	if( sourceIT == mSources.end() )
+		return 0;
+
+	if( sourceIT->second.mSize != pSize || sourceIT->second.mTime != pTime )
+		return 0;
+
+	sourceIT->second.mSeen = true;
+	return &sourceIT->second;
+}
+
+// Record a freshly scanned source
+void cCastleIndex::store( const sCastleIndexSource &pSource ) {
+	sCastleIndexSource *source = &mSources[ keyGet( pSource.mSource, pSource.mFilename ) ];
+
+	*source = pSource;
+	source->mSeen = true;
+
+	mChanged = true;
+}
+
+// Forget a source which has gone or changed
+void cCastleIndex::remove( eCastleSource pSource, string pFilename ) {
+
+	if( mSources.erase( keyGet( pSource, pFilename ) ) )
+		mChanged = true;
+}
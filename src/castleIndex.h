@@ -0,0 +1,98 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Castle Index Cache
+ *  ------------------------------------------
+ */
+
+#define CASTLE_INDEX_PATH		"cache"
+#define CASTLE_INDEX_FILE		"castles.idx"
+#define CASTLE_INDEX_VERSION	1
+
+#define CASTLE_SCAN_THREADS_MAX	16			// Upper limit of disk reading threads
+
+class cD64;
+
+enum eCastleSource {
+	eCastleSource_Disk = 0,					// Disk images in data
+	eCastleSource_CastleDisk = 1,			// Disk images in data/castles
+	eCastleSource_Local = 2					// Loose Z files
+};
+
+struct sCastleIndexCastle {
+	string		 mName;						// Filename on the disk
+	byte		 mTrack, mSector;			// Start of the file chain
+	dword		 mSize;						// Number of blocks
+
+	sCastleIndexCastle() {
+		mTrack = mSector = 0;
+		mSize = 0;
+	}
+};
+
+struct sCastleIndexSource {
+	eCastleSource	 mSource;
+	string			 mFilename;
+	dword			 mSize, mTime;			// Size and modification time when the source was indexed
+	bool			 mSeen;					// Found during this scan
+
+	vector< sCastleIndexCastle > mCastles;
+
+	sCastleIndexSource() {
+		mSource = eCastleSource_Disk;
+		mSize = mTime = 0;
+		mSeen = false;
+	}
+};
+
+// A disk image found while scanning, opened by the scan pool when it isnt indexed
+struct sCastleScan {
+	eCastleSource	 mSource;
+	string			 mFilename;
+	dword			 mSize, mTime;
+	bool			 mOpen;					// Needs reading
+	cD64			*mDisk;					// Result of the read
+
+	sCastleScan() {
+		mSource = eCastleSource_Disk;
+		mSize = mTime = 0;
+		mOpen = false;
+		mDisk = 0;
+	}
+};
+
+class cCastleIndex {
+private:
+	map< string, sCastleIndexSource >	 mSources;		// Indexed sources, by type and filename
+	bool								 mChanged;
+
+	string								 keyGet( eCastleSource pSource, string pFilename );
+
+public:
+										 cCastleIndex();
+
+	bool								 load();		// Read the index, a missing or stale index is empty
+	bool								 save();		// Write the index, dropping sources which have gone
+
+	sCastleIndexSource					*find( eCastleSource pSource, string pFilename, dword pSize, dword pTime );
+	void								 store( const sCastleIndexSource &pSource );
+	void								 remove( eCastleSource pSource, string pFilename );
+};
@@ -26,43 +26,140 @@
 #include "stdafx.h"
 #include "d64.h"
 #include "castle/castle.h"
+#include "castleIndex.h"
+#include "castlePack.h"
+#include "castleWatch.h"
 #include "castleManager.h"
+#include "saveQueue.h"
 #include "creep.h"
 
+// Holds the manager lock until the end of the scope
+class cCastleManagerLock {
+	cCastleManager	*mCastleManager;
+
+public:
+	cCastleManagerLock( cCastleManager *pCastleManager ) {
+		mCastleManager = pCastleManager;
+		mCastleManager->lock();
+	}
+
+	~cCastleManagerLock() {
+		mCastleManager->unlock();
+	}
+};
+
 cCastleInfoD64::cCastleInfoD64( cCastleManager *pCastleManager, cD64 *pD64, sD64File *pFile ) : cCastleInfo( pCastleManager, pFile->mName ) {
 	mD64 = pD64;
 	mFile = pFile;
+	mSource = pD64->filenameGet();
 
-	mBufferSize	= mFile->mBufferSize;
+	mTrack = pFile->mTrack;
+	mSector = pFile->mSector;
 }
 
-byte *cCastleInfoD64::bufferGet() {
-	return mFile->mBuffer;
+cCastleInfoD64::cCastleInfoD64( cCastleManager *pCastleManager, string pDiskName, const sCastleIndexCastle &pCastle ) : cCastleInfo( pCastleManager, pCastle.mName ) {
+	mD64 = 0;
+	mFile = 0;
+
+	mDiskName = pDiskName;
+	mSource = string( "castles/" ) + pDiskName;
+	mTrack = pCastle.mTrack;
+	mSector = pCastle.mSector;
 }
 
-cCastleInfoLocal::cCastleInfoLocal( cCastleManager *pCastleManager, sFileLocal *pFileLocal ) : cCastleInfo( pCastleManager, pFileLocal->mFilename ) {
-	mLocal = pFileLocal;
-	mBufferSize = mLocal->mBufferSize;
+byte *cCastleInfoD64::bufferGet() {
+	cCastleManagerLock lock( mCastleManager );
+
+	// Indexed castles open their disk when first used
+	if( !mFile ) {
+		if( !mD64 )
+			mD64 = mCastleManager->diskCastleGet( mDiskName );
+
+		if( mD64 )
+			mFile = mD64->fileGet( mTrack, mSector );
 
+		if( !mFile )
+			return 0;
+	}
+
+	byte *buffer = mFile->bufferGet();
+
+	// The size is only known once the file has been extracted
+	mBufferSize	= mFile->mBufferSize;
+	return buffer;
+}
+
+cCastleInfoLocal::cCastleInfoLocal( cCastleManager *pCastleManager, string pFilename ) : cCastleInfo( pCastleManager, pFilename ) {
+	mLocal = 0;
+	mFilename = pFilename;
+	mSource = string( "castles/" ) + pFilename;
 }
 
 byte *cCastleInfoLocal::bufferGet() {
+
+	if( !mLocal ) {
+		mLocal = mCastleManager->localCastleLoad( mFilename );
+
+		if( !mLocal )
+			return 0;
+
+		mBufferSize = mLocal->mBufferSize;
+	}
+
 	return mLocal->mBuffer;
 }
 
+cCastleInfoPack::cCastleInfoPack( cCastleManager *pCastleManager, cCastlePack *pPack, const sCastlePackEntry *pEntry ) : cCastleInfo( pCastleManager, pPack->nameGet( pEntry ) ) {
+	mPack = pPack;
+	mEntry = pEntry;
+	mBuffer = 0;
+	mSource = string( "castles/" ) + pPack->filenameGet();
+}
+
+cCastleInfoPack::~cCastleInfoPack() {
+
+	delete[] mBuffer;
+}
+
+byte *cCastleInfoPack::bufferGet() {
+
+	if( !mBuffer )
+		mBuffer = mPack->extract( mEntry, mBufferSize );
+
+	return mBuffer;
+}
+
 cCastleManager::cCastleManager() {
 	mCastle = 0;
+	mIndex = new cCastleIndex();
+	mLock = SDL_CreateMutex();
+	mSaveCatalogReady = false;
 
 	castlesFind();
+
+	mSaveQueue = new cSaveQueue( this );
+	mWatch = new cCastleWatch();
 }
 
 cCastleManager::~cCastleManager() {
+
+	delete mWatch;
+
+	// Finish writing any queued saves first
+	delete mSaveQueue;
+
 	castlesCleanup();
 	diskCleanup();
 	diskPosCleanup();
+	diskCastlesCleanup();
 	localCleanup();
+	packCleanup();
+	retiredCleanup();
 
 	delete mCastle;
+	delete mIndex;
+
+	SDL_DestroyMutex( mLock );
 }
 
 void cCastleManager::castlesCleanup() {
@@ -70,6 +167,9 @@ void cCastleManager::castlesCleanup() {
 
 	for( castleIT = mCastles.begin(); castleIT != mCastles.end(); ++castleIT )
 		delete *castleIT;
+
+	mCastles.clear();
+	mCastleNames.clear();
 }
 
 void cCastleManager::localCleanup() {
@@ -77,24 +177,38 @@ void cCastleManager::localCleanup() {
 
 	for( fileIT = mFiles.begin(); fileIT != mFiles.end(); ++fileIT )
 		delete (*fileIT);
+
+	mFiles.clear();
 }
 
 void cCastleManager::castlesFind() {
+	vector< sCastleScan >	scans;
 	
 	// Cleanup current open files
 	castlesCleanup();
 	diskCleanup();
+	diskCastlesCleanup();
 	localCleanup();
+	packCleanup();
+	retiredCleanup();
+
+	mIndex->load();
 
-	// Find any d64 images in data
-	disksFind( ".d64" );
-	diskCastleFind( ".d64" );
+	// Find any d64 images in data, and castle disks which changed since the last run
+	disksFind( ".d64", scans );
+	diskCastleScanFind( ".d64", scans );
 
-	// Load castles from main Disk images, and from data\castle folder
+	// Read them in parallel
+	disksScan( scans );
+
+	// Load castles from main Disk images, and from data\castle folder, in that order
 	diskLoadCastles();
-	diskLoadCastle();
+	diskLoadCastle( scans );
+	packLoadCastles();
 	localLoadCastles();
 
+	mIndex->save();
+
 	// Ensure atleast one disk was found
 	if( mDisks.size() == 0 ) {
 		cout << "No Commodore 64 Disk Images found in data directory\nPress Enter to exit";
@@ -107,14 +221,25 @@ void cCastleManager::castlesFind() {
 }
 
 cCastleInfo *cCastleManager::castleInfoGet( string pName ) {
-	vector< cCastleInfo* >::iterator castleIT;
+	map< string, cCastleInfo* >::iterator castleIT = mCastleNames.find( pName );
 
-	// Find a castle
-	for( castleIT = mCastles.begin(); castleIT != mCastles.end(); ++castleIT )
-		if( (*castleIT)->nameGet() == pName )
-			return (*castleIT);
+	if( castleIT == mCastleNames.end() )
+		return 0;
 
-	return 0;
+	return castleIT->second;
+}
+
+bool cCastleManager::castleAdd( cCastleInfo *pCastle ) {
+
+	// Dont add castles with the same name as already existing castles
+	if( castleInfoGet( pCastle->nameGet() ) ) {
+		delete pCastle;
+		return false;
+	}
+
+	mCastleNames[ pCastle->nameGet() ] = pCastle;
+	mCastles.push_back( pCastle );
+	return true;
 }
 
 cCastleInfo *cCastleManager::castleInfoGet( size_t pNumber ) {
@@ -173,43 +298,58 @@ void cCastleManager::diskLoadCastles() {
 	for( diskIT = mDisks.begin(); diskIT != mDisks.end(); ++diskIT ) {
 		vector<sD64File*>	files = (*diskIT)->directoryGet( "Z*" );
 
-		for( fileIT = files.begin(); fileIT != files.end(); ++fileIT ) {
-			
-			cCastleInfoD64 *castle = new cCastleInfoD64( this, (*diskIT), (*fileIT) );
-
-			// Dont add castles with the same name as already existing castles
-			if( castleInfoGet( castle->nameGet() ) ) {
-				delete castle;
-				continue;
-			}
-			
-			mCastles.push_back( castle );	
-		}
+		for( fileIT = files.begin(); fileIT != files.end(); ++fileIT )
+			castleAdd( new cCastleInfoD64( this, (*diskIT), (*fileIT) ) );
 	}
 
 	return;
 }
 
-void cCastleManager::diskLoadCastle() {
-	vector< cD64* >::iterator	diskIT;
-	vector< sD64File*>::iterator	fileIT;
+void cCastleManager::diskLoadCastle( vector< sCastleScan > &pScans ) {
+	vector< sCastleScan >::iterator			 scanIT;
+	vector< sD64File* >::iterator			 fileIT;
+	vector< sCastleIndexCastle >::iterator	 castleIT;
 
-	// Loop thro each file starting with Z of each disk
-	for( diskIT = mDisksCastles.begin(); diskIT != mDisksCastles.end(); ++diskIT ) {
-		vector<sD64File*>	files = (*diskIT)->directoryGet( "Z*" );
+	// Loop thro each castle disk in directory order, indexing those which were read
+	for( scanIT = pScans.begin(); scanIT != pScans.end(); ++scanIT ) {
 
-		for( fileIT = files.begin(); fileIT != files.end(); ++fileIT ) {
-			
-			cCastleInfoD64 *castle = new cCastleInfoD64( this, (*diskIT), (*fileIT) );
+		if( scanIT->mSource != eCastleSource_CastleDisk )
+			continue;
 
-			// Dont add castles with the same name as already existing castles
-			if( castleInfoGet( castle->nameGet() ) ) {
-				delete castle;
+		sCastleIndexSource *source = mIndex->find( eCastleSource_CastleDisk, scanIT->mFilename, scanIT->mSize, scanIT->mTime );
+
+		if( !source ) {
+			sCastleIndexSource	 scanned;
+			cD64				*disk = scanIT->mDisk;
+
+			if( !disk )
 				continue;
+
+			vector<sD64File*>	 files = disk->directoryGet( "Z*" );
+			mDisksCastles.push_back( disk );
+
+			scanned.mSource = eCastleSource_CastleDisk;
+			scanned.mFilename = scanIT->mFilename;
+			scanned.mSize = scanIT->mSize;
+			scanned.mTime = scanIT->mTime;
+
+			for( fileIT = files.begin(); fileIT != files.end(); ++fileIT ) {
+				sCastleIndexCastle castle;
+
+				castle.mName = (*fileIT)->mName;
+				castle.mTrack = (*fileIT)->mTrack;
+				castle.mSector = (*fileIT)->mSector;
+				castle.mSize = (*fileIT)->mFileSize;
+
+				scanned.mCastles.push_back( castle );
 			}
-			
-			mCastles.push_back( castle );	
+
+			mIndex->store( scanned );
+			source = mIndex->find( eCastleSource_CastleDisk, scanIT->mFilename, scanIT->mSize, scanIT->mTime );
 		}
+
+		for( castleIT = source->mCastles.begin(); castleIT != source->mCastles.end(); ++castleIT )
+			castleAdd( new cCastleInfoD64( this, scanIT->mFilename, *castleIT ) );
 	}
 
 	return;
@@ -226,19 +366,113 @@ byte *cCastleManager::diskLoadFile( string pFilename, size_t &pBufferSize ) {
 		if(files.size() == 0)
 			continue;
 
+		byte *buffer = files[0]->bufferGet();
+
 		pBufferSize = files[0]->mBufferSize;
-		return files[0]->mBuffer;
+		return buffer;
 	}
 
 	return 0;
 }
 
-void cCastleManager::disksFind( string pExtension ) {
+void cCastleManager::disksFind( string pExtension, vector< sCastleScan > &pScans ) {
 	vector<string> disks = directoryList( "", pExtension, false );
 	vector<string>::iterator diskIT;
 
+	// The main disks are always read, the intro and music come from them
 	for( diskIT = disks.begin(); diskIT != disks.end(); ++diskIT ) {
-		mDisks.push_back( new cD64( *diskIT, "" ) );
+		sCastleScan scan;
+
+		scan.mSource = eCastleSource_Disk;
+		scan.mFilename = *diskIT;
+		scan.mOpen = true;
+
+		pScans.push_back( scan );
+	}
+}
+
+void cCastleManager::diskCastleScanFind( string pExtension, vector< sCastleScan > &pScans ) {
+	vector<string> disks = directoryList( "castles", pExtension, false );
+	vector<string>::iterator diskIT;
+
+	for( diskIT = disks.begin(); diskIT != disks.end(); ++diskIT ) {
+		sCastleScan scan;
+		size_t		size = 0;
+
+		if( !local_FileStat( *diskIT, "castles", false, size, scan.mTime ) )
+			continue;
+
+		scan.mSource = eCastleSource_CastleDisk;
+		scan.mFilename = *diskIT;
+		scan.mSize = (dword) size;
+
+		// Only read disks which changed since they were indexed
+		scan.mOpen = (mIndex->find( eCastleSource_CastleDisk, scan.mFilename, scan.mSize, scan.mTime ) == 0);
+
+		pScans.push_back( scan );
+	}
+}
+
+struct sCastleScanPool {
+	vector< sCastleScan* >	 mQueue;
+	SDL_atomic_t			 mNext;
+};
+
+// Take disks off the queue until it is empty
+static int cCastleManager_ScanThread( void *userdata ) {
+	sCastleScanPool *pool = (sCastleScanPool*) userdata;
+
+	for(;;) {
+		size_t next = (size_t) SDL_AtomicAdd( &pool->mNext, 1 );
+
+		if( next >= pool->mQueue.size() )
+			break;
+
+		sCastleScan *scan = pool->mQueue[ next ];
+
+		if( scan->mSource == eCastleSource_Disk )
+			scan->mDisk = new cD64( scan->mFilename, "" );
+		else
+			scan->mDisk = new cD64( scan->mFilename, "castles", false, false, false );
+	}
+
+	return 0;
+}
+
+// Read the queued disks across a pool of threads, the results stay in directory order
+void cCastleManager::disksScan( vector< sCastleScan > &pScans ) {
+	vector< sCastleScan >::iterator		 scanIT;
+	vector< SDL_Thread* >				 threads;
+	vector< SDL_Thread* >::iterator		 threadIT;
+	sCastleScanPool						 pool;
+
+	for( scanIT = pScans.begin(); scanIT != pScans.end(); ++scanIT ) {
+		if( scanIT->mOpen )
+			pool.mQueue.push_back( &(*scanIT) );
+	}
+
+	SDL_AtomicSet( &pool.mNext, 0 );
+
+	size_t count = min( (size_t) max( SDL_GetCPUCount(), 1 ), (size_t) CASTLE_SCAN_THREADS_MAX );
+	count = min( count, pool.mQueue.size() );
+
+	// This thread is one of the workers
+	for( size_t i = 1; i < count; ++i ) {
+		SDL_Thread *thread = SDL_CreateThread( cCastleManager_ScanThread, "creep disk scan", &pool );
+
+		if( thread )
+			threads.push_back( thread );
+	}
+
+	cCastleManager_ScanThread( &pool );
+
+	for( threadIT = threads.begin(); threadIT != threads.end(); ++threadIT )
+		SDL_WaitThread( *threadIT, 0 );
+
+	// Main disks are kept in directory order
+	for( scanIT = pScans.begin(); scanIT != pScans.end(); ++scanIT ) {
+		if( scanIT->mSource == eCastleSource_Disk && scanIT->mDisk )
+			mDisks.push_back( scanIT->mDisk );
 	}
 }
 
@@ -254,15 +488,78 @@ void cCastleManager::diskPosFind( string pExtension ) {
 	}
 }
 
+// Open every save disk once, and index their files by name
+void cCastleManager::saveCatalogBuild() {
+	vector< cD64* >::iterator		 diskIT;
+	vector< sD64File* >::iterator	 fileIT;
+
+	if( mSaveCatalogReady )
+		return;
+
+	mSaveCatalog.clear();
+	diskPosFind(".d64");
+
+	for( diskIT = mDisksPositions.begin(); diskIT != mDisksPositions.end(); ++diskIT ) {
+		vector< sD64File* > *files = (*diskIT)->directoryGet();
+
+		// Saves replace their previous copy, so only disks written before that can hold two. The first found wins
+		for( fileIT = files->begin(); fileIT != files->end(); ++fileIT ) {
+			if( (*fileIT)->mFileType == eD64FileType_DEL || mSaveCatalog.find( (*fileIT)->mName ) != mSaveCatalog.end() )
+				continue;
+
+			mSaveCatalog[ (*fileIT)->mName ] = sSaveEntry( (*diskIT), (*fileIT) );
+		}
+	}
+
+	mSaveCatalogReady = true;
+}
+
+sSaveEntry *cCastleManager::saveCatalogFind( string pFilename ) {
+	map< string, sSaveEntry >::iterator entryIT;
+
+	saveCatalogBuild();
+
+	// C64 filenames are upper case
+	transform( pFilename.begin(), pFilename.end(), pFilename.begin(), ::toupper );
+
+	entryIT = mSaveCatalog.find( pFilename );
+	if( entryIT == mSaveCatalog.end() )
+		return 0;
+
+	return &entryIT->second;
+}
+
+// Record a freshly written file, replacing any older copy
+bool cCastleManager::saveCatalogAdd( cD64 *pDisk, sD64File *pFile ) {
+	if( !pFile )
+		return false;
+
+	mSaveCatalog[ pFile->mName ] = sSaveEntry( pDisk, pFile );
+	return true;
+}
+
 void cCastleManager::diskCastleFind( string pExtension ) {
 	vector<string> disks = directoryList( "castles", pExtension, false );
 	vector<string>::iterator diskIT;
 
-	diskCastlesCleanup();
+	// Open any castle disks not already in use
+	for( diskIT = disks.begin(); diskIT != disks.end(); ++diskIT )
+		diskCastleGet( *diskIT );
+}
 
-	for( diskIT = disks.begin(); diskIT != disks.end(); ++diskIT ) {
-		mDisksCastles.push_back( new cD64( *diskIT, "castles", false, false, false ) );
+cD64 *cCastleManager::diskCastleGet( string pFilename ) {
+	cCastleManagerLock		  lock( this );
+	vector< cD64* >::iterator diskIT;
+
+	for( diskIT = mDisksCastles.begin(); diskIT != mDisksCastles.end(); ++diskIT ) {
+		if( (*diskIT)->filenameGet() == pFilename )
+			return *diskIT;
 	}
+
+	cD64 *disk = new cD64( pFilename, "castles", false, false, false );
+	mDisksCastles.push_back( disk );
+
+	return disk;
 }
 
 void cCastleManager::localLoadCastles() {
@@ -270,28 +567,344 @@ void cCastleManager::localLoadCastles() {
 	vector<string>::iterator fileIT;
 
 	for( fileIT = files.begin(); fileIT != files.end(); ++fileIT ) {
-		sFileLocal *file = fileFind( (*fileIT) );
+		size_t	size = 0;
+		dword	time = 0;
 
-		if(!file) {
-			size_t size = 0;
-			byte *buffer = local_FileRead( (*fileIT) , "castles", size, false );
-			if(buffer)
-				mFiles.push_back( file = new sFileLocal( (*fileIT), buffer, size ));
-			else
-				continue;
+		// The file is read when the castle is first played
+		if( !local_FileStat( (*fileIT), "castles", false, size, time ) )
+			continue;
+
+		castleAdd( new cCastleInfoLocal( this, (*fileIT) ) );
+	}
+	
+}
+
+void cCastleManager::packCleanup() {
+	vector< cCastlePack* >::iterator	packIT;
+
+	for( packIT = mPacks.begin(); packIT != mPacks.end(); ++packIT )
+		delete (*packIT);
+
+	mPacks.clear();
+}
+
+void cCastleManager::packLoadCastles() {
+	vector<string>			 files = directoryList( "castles", CASTLE_PACK_EXT, false );
+	vector<string>::iterator fileIT;
+
+	for( fileIT = files.begin(); fileIT != files.end(); ++fileIT )
+		packLoad( *fileIT );
+}
+
+void cCastleManager::packLoad( string pFilename ) {
+	cCastlePack *pack = new cCastlePack( pFilename );
 
+	if( !pack->readyGet() ) {
+		delete pack;
+		return;
+	}
+
+	mPacks.push_back( pack );
+
+	// Castles are unpacked when first played
+	for( dword entry = 0; entry < pack->countGet(); ++entry )
+		castleAdd( new cCastleInfoPack( this, pack, pack->entryGet( entry ) ) );
+}
+
+bool cCastleManager::castlePackCreate( string pFilename ) {
+	vector< cCastleInfo* >::iterator	castleIT;
+	vector< sCastlePackSource >			castles;
+
+	for( castleIT = mCastles.begin(); castleIT != mCastles.end(); ++castleIT ) {
+		sCastlePackSource source;
+
+		source.mData = (*castleIT)->bufferGet();
+		source.mSize = (*castleIT)->bufferSizeGet();
+
+		string name = "Z" + (*castleIT)->nameGet();
+		transform( name.begin(), name.end(), name.begin(), ::toupper );
+
+		if( !source.mData || name.size() > CASTLE_PACK_NAME ) {
+			cout << " Skipping " << (*castleIT)->nameGet() << endl;
+			continue;
 		}
-		cCastleInfoLocal *local = new cCastleInfoLocal( this, file );
-		
-		// Dont add castles with the same name as already existing castles
-		if( castleInfoGet( local->nameGet() ) ) {
-			delete local;
+
+		source.mName = name;
+		castles.push_back( source );
+	}
+
+	local_DirectoryCreate( "castles", false );
+
+	if( !cCastlePack::write( pFilename, castles ) ) {
+		cout << " Unable to write castle pack " << pFilename << endl;
+		return false;
+	}
+
+	cout << " " << castles.size() << " castles written to " << pFilename << endl;
+	return true;
+}
+
+void cCastleManager::retiredCleanup() {
+	vector< cCastleInfo* >::iterator	castleIT;
+	vector< cD64* >::iterator			diskIT;
+	vector< cCastlePack* >::iterator	packIT;
+	vector< sFileLocal* >::iterator		fileIT;
+
+	for( castleIT = mRetiredCastles.begin(); castleIT != mRetiredCastles.end(); ++castleIT )
+		delete *castleIT;
+
+	for( diskIT = mRetiredDisks.begin(); diskIT != mRetiredDisks.end(); ++diskIT )
+		delete *diskIT;
+
+	for( packIT = mRetiredPacks.begin(); packIT != mRetiredPacks.end(); ++packIT )
+		delete *packIT;
+
+	for( fileIT = mRetiredFiles.begin(); fileIT != mRetiredFiles.end(); ++fileIT )
+		delete *fileIT;
+
+	mRetiredCastles.clear();
+	mRetiredDisks.clear();
+	mRetiredPacks.clear();
+	mRetiredFiles.clear();
+}
+
+// Is 'pBuffer' inside one of the disks files
+static bool diskBufferHolds( cD64 *pDisk, const byte *pBuffer ) {
+	vector< sD64File* >				*files = pDisk->directoryGet();
+	vector< sD64File* >::iterator	 fileIT;
+
+	for( fileIT = files->begin(); fileIT != files->end(); ++fileIT ) {
+		if( (*fileIT)->mBuffer && pBuffer >= (*fileIT)->mBuffer && pBuffer < (*fileIT)->mBuffer + (*fileIT)->mBufferSize )
+			return true;
+	}
+
+	return false;
+}
+
+// Free retired castles and their files, unless the current castle or the music is still read from them
+void cCastleManager::retiredRelease( const byte *pMusic ) {
+	cCastleInfo							*current = mCastle ? mCastle->infoGet() : 0;
+	vector< cCastleInfo* >::iterator	 castleIT;
+	vector< cD64* >::iterator			 diskIT;
+	vector< cCastlePack* >::iterator	 packIT;
+	vector< sFileLocal* >::iterator		 fileIT;
+
+	for( castleIT = mRetiredCastles.begin(); castleIT != mRetiredCastles.end(); ) {
+		if( *castleIT == current ) {
+			++castleIT;
 			continue;
 		}
 
-		mCastles.push_back( local );
+		delete *castleIT;
+		castleIT = mRetiredCastles.erase( castleIT );
 	}
-	
+
+	for( diskIT = mRetiredDisks.begin(); diskIT != mRetiredDisks.end(); ) {
+		if( (current && current->sourceUses( *diskIT )) || (pMusic && diskBufferHolds( *diskIT, pMusic )) ) {
+			++diskIT;
+			continue;
+		}
+
+		delete *diskIT;
+		diskIT = mRetiredDisks.erase( diskIT );
+	}
+
+	for( packIT = mRetiredPacks.begin(); packIT != mRetiredPacks.end(); ) {
+		if( current && current->sourceUses( *packIT ) ) {
+			++packIT;
+			continue;
+		}
+
+		delete *packIT;
+		packIT = mRetiredPacks.erase( packIT );
+	}
+
+	for( fileIT = mRetiredFiles.begin(); fileIT != mRetiredFiles.end(); ) {
+		if( (current && current->sourceUses( *fileIT )) || (pMusic && pMusic >= (*fileIT)->mBuffer && pMusic < (*fileIT)->mBuffer + (*fileIT)->mBufferSize) ) {
+			++fileIT;
+			continue;
+		}
+
+		delete *fileIT;
+		fileIT = mRetiredFiles.erase( fileIT );
+	}
+}
+
+void cCastleManager::castlesRemove( string pSource ) {
+	vector< cCastleInfo* >::iterator castleIT;
+
+	for( castleIT = mCastles.begin(); castleIT != mCastles.end(); ) {
+
+		if( (*castleIT)->sourceGet() != pSource ) {
+			++castleIT;
+			continue;
+		}
+
+		map< string, cCastleInfo* >::iterator nameIT = mCastleNames.find( (*castleIT)->nameGet() );
+		if( nameIT != mCastleNames.end() && nameIT->second == *castleIT )
+			mCastleNames.erase( nameIT );
+
+		mRetiredCastles.push_back( *castleIT );
+
+		castleIT = mCastles.erase( castleIT );
+	}
+}
+
+// Retire everything loaded from one file, then load it again if it is still there
+bool cCastleManager::castleSourceReload( string pPath, string pFilename ) {
+	string	extension = pFilename.substr( min( pFilename.size(), pFilename.rfind( '.' ) ) );
+	string	packExtension = CASTLE_PACK_EXT;
+	string	journalExtension = D64_JOURNAL_EXT;
+	size_t	size = 0;
+	dword	time = 0;
+
+	transform( extension.begin(), extension.end(), extension.begin(), ::toupper );
+	transform( packExtension.begin(), packExtension.end(), packExtension.begin(), ::toupper );
+	transform( journalExtension.begin(), journalExtension.end(), journalExtension.begin(), ::toupper );
+
+	bool exists = local_FileStat( pFilename, pPath, false, size, time );
+
+	// Main disks in the data folder
+	if( pPath.empty() ) {
+		vector< cD64* >::iterator diskIT;
+
+		if( extension != ".D64" )
+			return false;
+
+		castlesRemove( pFilename );
+
+		for( diskIT = mDisks.begin(); diskIT != mDisks.end(); ++diskIT ) {
+			if( (*diskIT)->filenameGet() == pFilename ) {
+				mRetiredDisks.push_back( *diskIT );
+				mDisks.erase( diskIT );
+				break;
+			}
+		}
+
+		if( exists ) {
+			cD64 *disk = new cD64( pFilename, "" );
+			vector< sD64File* > files = disk->directoryGet( "Z*" );
+			vector< sD64File* >::iterator fileIT;
+
+			mDisks.push_back( disk );
+
+			for( fileIT = files.begin(); fileIT != files.end(); ++fileIT )
+				castleAdd( new cCastleInfoD64( this, disk, *fileIT ) );
+		}
+
+		return true;
+	}
+
+	castlesRemove( string( "castles/" ) + pFilename );
+
+	// Castle disks
+	if( extension == ".D64" ) {
+		vector< cD64* >::iterator diskIT;
+
+		for( diskIT = mDisksCastles.begin(); diskIT != mDisksCastles.end(); ++diskIT ) {
+			if( (*diskIT)->filenameGet() == pFilename ) {
+				mRetiredDisks.push_back( *diskIT );
+				mDisksCastles.erase( diskIT );
+				break;
+			}
+		}
+
+		mIndex->remove( eCastleSource_CastleDisk, pFilename );
+
+		if( exists ) {
+			vector< sCastleScan > scans( 1 );
+
+			scans[0].mSource = eCastleSource_CastleDisk;
+			scans[0].mFilename = pFilename;
+			scans[0].mSize = (dword) size;
+			scans[0].mTime = time;
+			scans[0].mOpen = true;
+			scans[0].mDisk = new cD64( pFilename, "castles", false, false, false );
+
+			diskLoadCastle( scans );
+		}
+
+		return true;
+	}
+
+	// Castle packs
+	if( extension == packExtension ) {
+		vector< cCastlePack* >::iterator packIT;
+
+		for( packIT = mPacks.begin(); packIT != mPacks.end(); ++packIT ) {
+			if( (*packIT)->filenameGet() == pFilename ) {
+				mRetiredPacks.push_back( *packIT );
+				mPacks.erase( packIT );
+				break;
+			}
+		}
+
+		if( exists )
+			packLoad( pFilename );
+
+		return true;
+	}
+
+	// Loose castle files
+	if( toupper( pFilename[0] ) == 'Z' && extension != journalExtension ) {
+		vector< sFileLocal* >::iterator fileIT;
+
+		for( fileIT = mFiles.begin(); fileIT != mFiles.end(); ++fileIT ) {
+			if( (*fileIT)->mFilename == pFilename ) {
+				mRetiredFiles.push_back( *fileIT );
+				mFiles.erase( fileIT );
+				break;
+			}
+		}
+
+		if( exists )
+			castleAdd( new cCastleInfoLocal( this, pFilename ) );
+
+		return true;
+	}
+
+	return false;
+}
+
+bool cCastleManager::castlesReload( const byte *pMusic ) {
+	vector< sCastleChange >				changes;
+	vector< sCastleChange >::iterator	changeIT;
+	bool								changed = false;
+
+	if( !mWatch->changesGet( changes ) )
+		return false;
+
+	cCastleManagerLock lock( this );
+
+	for( changeIT = changes.begin(); changeIT != changes.end(); ++changeIT ) {
+
+		if( castleSourceReload( changeIT->mPath, changeIT->mFilename ) ) {
+			cout << " Castles reloaded from " << (changeIT->mPath.size() ? changeIT->mPath + "/" : "") << changeIT->mFilename << endl;
+			changed = true;
+		}
+	}
+
+	// Only the current castle and the music can still be reading what was replaced
+	retiredRelease( pMusic );
+
+	mIndex->save();
+	return changed;
+}
+
+sFileLocal *cCastleManager::localCastleLoad( string pFilename ) {
+	sFileLocal *file = fileFind( pFilename );
+
+	if(!file) {
+		size_t size = 0;
+		byte *buffer = local_FileRead( pFilename, "castles", size, false );
+
+		if(!buffer)
+			return 0;
+
+		mFiles.push_back( file = new sFileLocal( pFilename, buffer, size ));
+	}
+
+	return file;
 }
 
 sFileLocal *cCastleManager::fileFind( string pFilename ) {
@@ -373,25 +986,24 @@ cD64 *cCastleManager::castleDiskCreate() {
 }
 
 bool cCastleManager::positionLoad( string pFilename, byte *pTarget ) {
-	diskPosFind(".d64");
-	// Search all open disks  for filename
 
-	vector< cD64* >::iterator		 diskIT;
-	sD64File *file = 0;
+	// A save still waiting to be written is newer than anything on disk
+	if( mSaveQueue && mSaveQueue->pendingGet( eSaveType_Position, pFilename, pTarget ) )
+		return true;
 
-	for( diskIT = mDisksPositions.begin(); diskIT != mDisksPositions.end(); ++diskIT ) {
-		if( (file = (*diskIT)->fileGet( pFilename )) ) {
-			
-			// Copy the file from the d64 buffer, to the target memory buffer
-			memcpy( pTarget, file->mBuffer + 2, file->mBufferSize - 2);
-			return true;
-		}
-	}
+	cCastleManagerLock lock( this );
+	sSaveEntry *entry = saveCatalogFind( pFilename );
 
-	return false;
+	if( !entry || !entry->mFile->bufferGet() || entry->mFile->mBufferSize < 2 )
+		return false;
+
+	// Copy the file from the d64 buffer, to the target memory buffer
+	memcpy( pTarget, entry->mFile->mBuffer + 2, entry->mFile->mBufferSize - 2);
+	return true;
 }
 
 bool cCastleManager::castleSave( string pFilename, size_t pSaveSize, byte *pData ) {
+	cCastleManagerLock				 lock( this );
 	vector< cD64* >::iterator		 diskIT;
 	cD64							*disk = 0;
 
@@ -418,14 +1030,20 @@ bool cCastleManager::castleSave( string pFilename, size_t pSaveSize, byte *pData
 		disk = *diskIT;
 
 	// Save the file to the disk
-	return disk->fileSave( pFilename, pData, pSaveSize, 0x7800 );
+	return disk->fileSave( pFilename, pData, pSaveSize, 0x7800 ) != 0;
 }
 
 bool cCastleManager::positionSave( string pFilename, size_t pSaveSize, byte *pData  ) {
+	cCastleManagerLock				 lock( this );
 	vector< cD64* >::iterator		 diskIT;
 	cD64							*disk = 0;
+	sSaveEntry						 previous;
 
-	diskPosFind(".d64");
+	saveCatalogBuild();
+
+	sSaveEntry *entry = saveCatalogFind( pFilename );
+	if( entry )
+		previous = *entry;
 	
 	// Calculate number of sectors required for file we're saving
 	size_t size = pSaveSize + 2;
@@ -433,22 +1051,35 @@ bool cCastleManager::positionSave( string pFilename, size_t pSaveSize, byte *pDa
 	if(size % 254)
 		++sectors;
 
+	// The disk holding the previous copy first, the copy is then replaced in one write
+	if( previous.mDisk && previous.mDisk->sectorsFree() >= sectors )
+		disk = previous.mDisk;
+
 	// Search all available disks for enough available sectors 
-	for( diskIT = mDisksPositions.begin(); diskIT != mDisksPositions.end(); ++diskIT ) {
+	for( diskIT = mDisksPositions.begin(); !disk && diskIT != mDisksPositions.end(); ++diskIT ) {
 		
 		if( (*diskIT)->sectorsFree() >= sectors)
-			break;
+			disk = *diskIT;
 	}
 
 	// No Disk found? create a new save disk
-	if( diskIT == mDisksPositions.end() ) {
+	if( !disk ) {
 		disk = positionDiskCreate();
-		mDisksPositions.push_back( disk );
-	} else
-		disk = *diskIT;
+		if( disk )
+			mDisksPositions.push_back( disk );
+	}
 
-	// Save the file to the disk
-	return disk->fileSave( pFilename, pData, pSaveSize, 0x7800 );
+	// Save the file to the disk, the previous copy is scratched with it when both are on one disk
+	sD64File *file = disk ? disk->fileSave( pFilename, pData, pSaveSize, 0x7800, (previous.mDisk == disk) ? previous.mFile : 0 ) : 0;
+	if( !file )
+		return false;
+
+	// Otherwise only once the new copy is written
+	if( previous.mDisk && previous.mDisk != disk && !previous.mDisk->fileDelete( previous.mFile ) )
+		cout << "Unable to remove the previous copy of " << pFilename << endl;
+
+	// Point the catalog at the new copy
+	return saveCatalogAdd( disk, file );
 }
 
 bool cCastleManager::scoresLoad( string pCastleName, byte *pData ) {
@@ -470,6 +1101,31 @@ bool cCastleManager::scoresSave( string pCastleName, size_t pSaveSize, byte *pDa
 
 }
 
+// Hand a copy of the save to the worker thread, 'pComplete' is called from savesPoll once it is written
+void cCastleManager::castleSaveQueue( string pFilename, size_t pSaveSize, byte *pData, tSaveComplete pComplete, void *pUserData ) {
+
+	mSaveQueue->push( eSaveType_Castle, pFilename, pSaveSize, pData, pComplete, pUserData );
+}
+
+void cCastleManager::positionSaveQueue( string pFilename, size_t pSaveSize, byte *pData, tSaveComplete pComplete, void *pUserData ) {
+
+	mSaveQueue->push( eSaveType_Position, pFilename, pSaveSize, pData, pComplete, pUserData );
+}
+
+void cCastleManager::scoresSaveQueue( string pCastleName, size_t pSaveSize, byte *pData, tSaveComplete pComplete, void *pUserData ) {
+	stringstream filename;
+
+	filename << "Y";
+	filename << pCastleName;
+
+	positionSaveQueue( filename.str(), pSaveSize, pData, pComplete, pUserData );
+}
+
+void cCastleManager::savesPoll() {
+
+	mSaveQueue->poll();
+}
+
 vector<string> cCastleManager::musicGet() {
 	vector<string>		musicFiles = filesFind("MUSIC*");
 
@@ -527,6 +1183,10 @@ cCastle *cCastleManager::castleLoad( size_t pNumber ) {
 	if( pNumber >= mCastles.size() )
 		return 0;
 
+	// Disk or file has gone since the castles were found
+	if( !mCastles[ pNumber ]->bufferGet() )
+		return 0;
+
 	delete mCastle;
 	mCastle = new cCastle( cCreep::GetSingletonPtr(), mCastles[ pNumber ] );
 	
@@ -26,7 +26,16 @@
 class cCastleManager;
 class cCastle;
 class cD64;
+class cCastleIndex;
+class cCastlePack;
 struct sD64File;
+struct sCastlePackEntry;
+struct sCastleIndexCastle;
+struct sCastleScan;
+class cSaveQueue;
+class cCastleWatch;
+
+typedef void (*tSaveComplete)( void *pUserData, string pFilename, bool pResult );	// Called once a queued save has been written
 
 struct sFileLocal {
 	string	 mFilename;
@@ -44,10 +53,26 @@ struct sFileLocal {
 	}
 };
 
+struct sSaveEntry {
+	cD64		*mDisk;
+	sD64File	*mFile;
+
+	sSaveEntry() {
+		mDisk = 0;
+		mFile = 0;
+	}
+
+	sSaveEntry( cD64 *pDisk, sD64File *pFile ) {
+		mDisk = pDisk;
+		mFile = pFile;
+	}
+};
+
 class cCastleInfo {
 protected:
 	cCastleManager	*mCastleManager;
 	string			 mName;
+	string			 mSource;				// File the castle came from, relative to the data folder
 	size_t			 mBufferSize,		mCastleNumber;
 	
 public:
@@ -62,9 +87,13 @@ public:
 		mName[0] = toupper( mName[0] );
 	}
 
+	virtual			 ~cCastleInfo() { }
+
 	string			  nameGet() { return mName; }
+	string			  sourceGet() { return mSource; }
 	size_t			  bufferSizeGet() { return mBufferSize; }
 	virtual byte	 *bufferGet() = 0;
+	virtual bool	  sourceUses( const void *pSource ) { return false; }	// Is the castle read from 'pSource'
 	
 	inline cCastleManager *managerGet() { return mCastleManager; }
 	inline void				castleNumberSet( size_t pNumber ) { mCastleNumber = pNumber; }
@@ -75,49 +104,99 @@ class cCastleInfoD64 : public cCastleInfo {
 private:
 	cD64			*mD64;
 	sD64File		*mFile;
+
+	string			 mDiskName;				// Castle disk to open when first used
+	byte			 mTrack, mSector;
 	
 public:
 					 cCastleInfoD64( cCastleManager *pCastleManager, cD64 *pD64, sD64File *pFile );
+					 cCastleInfoD64( cCastleManager *pCastleManager, string pDiskName, const sCastleIndexCastle &pCastle );
 
 	byte			*bufferGet();
+	bool			 sourceUses( const void *pSource ) { return mD64 == pSource; }
 };
 
 class cCastleInfoLocal : public cCastleInfo {
 private:
 	sFileLocal		*mLocal;
+	string			 mFilename;				// Read when first used
 	
 public:
-					 cCastleInfoLocal( cCastleManager *pCastleManager, sFileLocal *pFileLocal );
+					 cCastleInfoLocal( cCastleManager *pCastleManager, string pFilename );
+
+	byte			*bufferGet();
+	bool			 sourceUses( const void *pSource ) { return mLocal == pSource; }
+};
+
+class cCastleInfoPack : public cCastleInfo {
+private:
+	cCastlePack					*mPack;
+	const sCastlePackEntry		*mEntry;
+	byte						*mBuffer;			// Unpacked when first used
+
+public:
+					 cCastleInfoPack( cCastleManager *pCastleManager, cCastlePack *pPack, const sCastlePackEntry *pEntry );
+					~cCastleInfoPack();
 
 	byte			*bufferGet();
+	bool			 sourceUses( const void *pSource ) { return mPack == pSource; }
 };
 
 class cCastleManager {
 private:
 	cCastle					*mCastle;				// Current Castle
 	vector< cCastleInfo* >	 mCastles;				// All castles found
+	map< string, cCastleInfo* > mCastleNames;		// All castles found, by name
+	cCastleIndex			*mIndex;				// Castles on the castle disks, from the last scan
+	cSaveQueue				*mSaveQueue;			// Writes saves on a worker thread
+	cCastleWatch			*mWatch;				// Sees castles added, changed or removed while running
+	SDL_mutex				*mLock;					// Held while the disks are used, by the game or the save worker
 	vector< cD64* >			 mDisks;				// Open disk images
 	vector< cD64* >			 mDisksPositions;		// Save Game Disks
 	vector< cD64* >			 mDisksCastles;			// Castle Disks
 	vector< sFileLocal* >	 mFiles;				// Open Local Files
+	vector< cCastlePack* >	 mPacks;				// Open Castle Packs
+
+	vector< cCastleInfo* >	 mRetiredCastles;		// Replaced while running, kept while the current castle or music uses them
+	vector< cD64* >			 mRetiredDisks;
+	vector< cCastlePack* >	 mRetiredPacks;
+	vector< sFileLocal* >	 mRetiredFiles;
+
+	map< string, sSaveEntry > mSaveCatalog;			// Save game files by name, across all save disks
+	bool					 mSaveCatalogReady;
 
 	void					 castlesCleanup();		// Cleanup mCastles vector
 	void					 castlesFind();			// Find all available castles
+	bool					 castleAdd( cCastleInfo *pCastle );	// Add a castle, unless the name is taken
+	void					 castlesRemove( string pSource );	// Retire the castles from one file
+	bool					 castleSourceReload( string pPath, string pFilename );	// Reload the castles from one changed file
+	void					 retiredCleanup();
+	void					 retiredRelease( const byte *pMusic );	// Free what the current castle and 'pMusic' dont use
 
 
 	void					 diskCleanup();			// Cleanup mDisks vector
 	void					 diskPosCleanup();
 	void					 diskCastlesCleanup();
 	void					 diskLoadCastles();		// Load all castles off disks
-	void					 diskLoadCastle();		// Load all castles off castle folder disks
+	void					 diskLoadCastle( vector< sCastleScan > &pScans );	// Load all castles off castle folder disks
 
-	void					 disksFind( string pExtension );		// Find all D64 Images
+	void					 disksFind( string pExtension, vector< sCastleScan > &pScans );		// Find all D64 Images
+	void					 diskCastleScanFind( string pExtension, vector< sCastleScan > &pScans );	// Find castle disks, and which need reading
+	void					 disksScan( vector< sCastleScan > &pScans );		// Read the queued disks across a pool of threads
 	void					 diskCastleFind( string pExtension );
 	void					 diskPosFind( string pExtension );
 
+	void					 saveCatalogBuild();	// Open the save disks once, and index their files
+	sSaveEntry				*saveCatalogFind( string pFilename );
+	bool					 saveCatalogAdd( cD64 *pDisk, sD64File *pFile );
+
 	void					 localCleanup();
 	void					 localLoadCastles();	// Load all castles in data folder
 
+	void					 packCleanup();
+	void					 packLoadCastles();		// Load all castles out of packs in castles folder
+	void					 packLoad( string pFilename );
+
 public:
 							 cCastleManager();
 							~cCastleManager();
@@ -125,6 +204,9 @@ public:
 	cCastle					*castleLoad( size_t pNumber );
 	cCastleInfo				*castleInfoGet( string pName );
 	cCastleInfo				*castleInfoGet( size_t pNumber );
+	cD64					*diskCastleGet( string pFilename );	// Open a castle disk, if it isnt already
+	bool					 castlesReload( const byte *pMusic );	// Apply changes seen by the watcher, true if the castle list changed
+	sFileLocal				*localCastleLoad( string pFilename );
 
 	void					 castleListDisplay();	// Display list of castles
 
@@ -143,10 +225,19 @@ public:
 	bool					 positionSave( string pFilename, size_t pSaveSize, byte *pData );
 	cD64					*positionDiskCreate();
 	cD64					*castleDiskCreate();
+	bool					 castlePackCreate( string pFilename );	// Write every castle found into one pack
 
 	bool					 scoresLoad( string pCastleName, byte *pData );
 	bool					 scoresSave( string pCastleName, size_t pSaveSize, byte *pData );
 
+	void					 castleSaveQueue( string pFilename, size_t pSaveSize, byte *pData, tSaveComplete pComplete, void *pUserData );
+	void					 positionSaveQueue( string pFilename, size_t pSaveSize, byte *pData, tSaveComplete pComplete, void *pUserData );
+	void					 scoresSaveQueue( string pCastleName, size_t pSaveSize, byte *pData, tSaveComplete pComplete, void *pUserData );
+	void					 savesPoll();			// Deliver completed saves
+
+	inline void				 lock()		{ SDL_LockMutex( mLock ); }
+	inline void				 unlock()	{ SDL_UnlockMutex( mLock ); }
+
 	vector<string>			 musicGet();
 
 };
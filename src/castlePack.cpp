@@ -0,0 +1,318 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Castle Pack Archive
+ *  ------------------------------------------
+ */
+
+#include "stdafx.h"
+#include "castlePack.h"
+
+// FNV-1a, checks the index and each castle
+static dword packHash( const byte *pBuffer, size_t pSize ) {
+	dword hash = 0x811C9DC5;
+
+	for( size_t i = 0; i < pSize; ++i ) {
+		hash ^= pBuffer[i];
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+// PackBits: a control byte of 0-127 is followed by that many literals plus one, 129-255 repeats the next byte 257 minus it times
+static void packBitsEncode( const byte *pSource, size_t pSize, vector< byte > &pTarget ) {
+	size_t pos = 0;
+
+	while( pos < pSize ) {
+		size_t run = 1;
+
+		while( pos + run < pSize && run < 128 && pSource[pos + run] == pSource[pos] )
+			++run;
+
+		if( run >= 3 ) {
+			pTarget.push_back( (byte) (257 - run) );
+			pTarget.push_back( pSource[pos] );
+			pos += run;
+			continue;
+		}
+
+		// Literals, up until the next run of three
+		size_t start = pos, count = 0;
+
+		while( pos < pSize && count < 128 ) {
+			if( pos + 2 < pSize && pSource[pos] == pSource[pos + 1] && pSource[pos] == pSource[pos + 2] )
+				break;
+
+			++pos;
+			++count;
+		}
+
+		pTarget.push_back( (byte) (count - 1) );
+		pTarget.insert( pTarget.end(), pSource + start, pSource + start + count );
+	}
+}
+
+static bool packBitsDecode( const byte *pSource, size_t pSize, byte *pTarget, size_t pLength ) {
+	size_t in = 0, out = 0;
+
+	while( in < pSize ) {
+		byte control = pSource[in++];
+
+		if( control < 128 ) {
+			size_t count = control + 1;
+
+			if( in + count > pSize || out + count > pLength )
+				return false;
+
+			memcpy( pTarget + out, pSource + in, count );
+			in += count;
+			out += count;
+
+		} else if( control > 128 ) {
+			size_t count = 257 - control;
+
+			if( in >= pSize || out + count > pLength )
+				return false;
+
+			memset( pTarget + out, pSource[in++], count );
+			out += count;
+		}
+	}
+
+	return out == pLength;
+}
+
+// Little-endian dwords, the pack reads the same on any host
+static dword packDwordRead( const byte *pBuffer ) {
+
+	return readLEWord( pBuffer ) | ((dword) readLEWord( pBuffer + 2 ) << 16);
+}
+
+static void packDwordWrite( byte *pBuffer, dword pValue ) {
+
+	writeLEWord( pBuffer, pValue & 0xFFFF );
+	writeLEWord( pBuffer + 2, (word) (pValue >> 16) );
+}
+
+static void packEntryRead( const byte *pBuffer, sCastlePackEntry &pEntry ) {
+	const byte *fields = pBuffer + CASTLE_PACK_NAME;
+
+	memcpy( pEntry.mName, pBuffer, CASTLE_PACK_NAME );
+	pEntry.mOffset = packDwordRead( fields );
+	pEntry.mSize = packDwordRead( fields + 4 );
+	pEntry.mLength = packDwordRead( fields + 8 );
+	pEntry.mChecksum = packDwordRead( fields + 12 );
+	pEntry.mFlags = packDwordRead( fields + 16 );
+}
+
+static void packEntryWrite( byte *pBuffer, const sCastlePackEntry &pEntry ) {
+	byte *fields = pBuffer + CASTLE_PACK_NAME;
+
+	memcpy( pBuffer, pEntry.mName, CASTLE_PACK_NAME );
+	packDwordWrite( fields, pEntry.mOffset );
+	packDwordWrite( fields + 4, pEntry.mSize );
+	packDwordWrite( fields + 8, pEntry.mLength );
+	packDwordWrite( fields + 12, pEntry.mChecksum );
+	packDwordWrite( fields + 16, pEntry.mFlags );
+}
+
+static bool packSourceCompare( const sCastlePackSource &pLeft, const sCastlePackSource &pRight ) {
+	return pLeft.mName < pRight.mName;
+}
+
+// Read the header and index of a pack in the castles folder, the castles stay on disk until played
+cCastlePack::cCastlePack( string pFilename ) {
+	byte header[ CASTLE_PACK_HEADER_SIZE ];
+
+	mFilename = pFilename;
+	mFileSize = 0;
+	mCount = 0;
+	mReady = false;
+
+	FILE *file = local_FileOpen( pFilename, "castles", false, "rb" );
+	if( !file )
+		return;
+
+	if( fseek( file, 0, SEEK_END ) == 0 ) {
+		long size = ftell( file );
+
+		if( size > 0 )
+			mFileSize = (size_t) size;
+	}
+
+	if( mFileSize < CASTLE_PACK_HEADER_SIZE || fseek( file, 0, SEEK_SET ) || fread( header, CASTLE_PACK_HEADER_SIZE, 1, file ) != 1 ) {
+		fclose( file );
+		return;
+	}
+
+	if( memcmp( header, "CRPK", 4 ) || packDwordRead( header + 4 ) != CASTLE_PACK_VERSION ) {
+		cout << "Castle pack: " << pFilename << " is not a supported pack" << endl;
+		fclose( file );
+		return;
+	}
+
+	dword count = packDwordRead( header + 8 );
+	dword checksum = packDwordRead( header + 12 );
+
+	if( count > ((mFileSize - CASTLE_PACK_HEADER_SIZE) / CASTLE_PACK_ENTRY_SIZE) ) {
+		cout << "Castle pack: " << pFilename << " has a damaged index" << endl;
+		fclose( file );
+		return;
+	}
+
+	vector< byte > index( (count * CASTLE_PACK_ENTRY_SIZE) + 1 );
+
+	bool result = (count == 0 || fread( &index[0], count * CASTLE_PACK_ENTRY_SIZE, 1, file ) == 1);
+	fclose( file );
+
+	if( !result || packHash( &index[0], count * CASTLE_PACK_ENTRY_SIZE ) != checksum ) {
+		cout << "Castle pack: " << pFilename << " has a damaged index" << endl;
+		return;
+	}
+
+	mEntries.resize( count );
+	for( dword i = 0; i < count; ++i )
+		packEntryRead( &index[ i * CASTLE_PACK_ENTRY_SIZE ], mEntries[i] );
+
+	mCount = count;
+	mReady = true;
+}
+
+const sCastlePackEntry *cCastlePack::entryGet( dword pIndex ) {
+
+	if( pIndex >= mCount )
+		return 0;
+
+	return &mEntries[ pIndex ];
+}
+
+string cCastlePack::nameGet( const sCastlePackEntry *pEntry ) {
+	size_t length = 0;
+
+	while( length < CASTLE_PACK_NAME && pEntry->mName[length] )
+		++length;
+
+	return string( pEntry->mName, length );
+}
+
+// Unpack a castle, the caller owns the buffer
+byte *cCastlePack::extract( const sCastlePackEntry *pEntry, size_t &pSize ) {
+
+	if( !pEntry || pEntry->mOffset > mFileSize || pEntry->mSize > mFileSize - pEntry->mOffset )
+		return 0;
+
+	if( pEntry->mLength > CASTLE_PACK_LENGTH_MAX || pEntry->mSize > CASTLE_PACK_LENGTH_MAX ) {
+		cout << "Castle pack: " << nameGet( pEntry ) << " in " << mFilename << " is too large" << endl;
+		return 0;
+	}
+
+	// Each extract opens the pack itself, so castles can be unpacked from any thread
+	FILE *file = local_FileOpen( mFilename, "castles", false, "rb" );
+	if( !file )
+		return 0;
+
+	vector< byte > stored( pEntry->mSize + 1 );
+
+	bool read = (fseek( file, (long) pEntry->mOffset, SEEK_SET ) == 0 && (pEntry->mSize == 0 || fread( &stored[0], pEntry->mSize, 1, file ) == 1));
+	fclose( file );
+
+	if( !read ) {
+		cout << "Castle pack: unable to read " << nameGet( pEntry ) << " from " << mFilename << endl;
+		return 0;
+	}
+
+	const byte	*source = &stored[0];
+	byte		*buffer = new byte[ pEntry->mLength ? pEntry->mLength : 1 ];
+	bool		 result;
+
+	if( pEntry->mFlags & eCastlePackFlag_RLE )
+		result = packBitsDecode( source, pEntry->mSize, buffer, pEntry->mLength );
+	else {
+		result = (pEntry->mSize == pEntry->mLength);
+
+		if( result )
+			memcpy( buffer, source, pEntry->mLength );
+	}
+
+	if( !result || packHash( buffer, pEntry->mLength ) != pEntry->mChecksum ) {
+		cout << "Castle pack: " << nameGet( pEntry ) << " in " << mFilename << " is damaged" << endl;
+
+		delete[] buffer;
+		return 0;
+	}
+
+	pSize = pEntry->mLength;
+	return buffer;
+}
+
+// Write a pack into the castles folder, each castle is run-length encoded if that makes it smaller
+bool cCastlePack::write( string pFilename, vector< sCastlePackSource > &pCastles ) {
+	vector< sCastlePackSource >::iterator	castleIT;
+	vector< sCastlePackEntry >				index;
+	vector< byte >							data, packed;
+
+	sort( pCastles.begin(), pCastles.end(), packSourceCompare );
+
+	size_t dataStart = CASTLE_PACK_HEADER_SIZE + (pCastles.size() * CASTLE_PACK_ENTRY_SIZE);
+
+	for( castleIT = pCastles.begin(); castleIT != pCastles.end(); ++castleIT ) {
+		sCastlePackEntry entry;
+
+		if( castleIT->mName.size() > CASTLE_PACK_NAME || castleIT->mSize > CASTLE_PACK_LENGTH_MAX )
+			return false;
+
+		memset( &entry, 0, sizeof( entry ) );
+		memcpy( entry.mName, castleIT->mName.c_str(), castleIT->mName.size() );
+
+		entry.mLength = (dword) castleIT->mSize;
+		entry.mChecksum = packHash( castleIT->mData, castleIT->mSize );
+		entry.mOffset = (dword) (dataStart + data.size());
+
+		packed.clear();
+		packBitsEncode( castleIT->mData, castleIT->mSize, packed );
+
+		if( packed.size() < castleIT->mSize ) {
+			entry.mFlags = eCastlePackFlag_RLE;
+			entry.mSize = (dword) packed.size();
+			data.insert( data.end(), packed.begin(), packed.end() );
+		} else {
+			entry.mSize = (dword) castleIT->mSize;
+			data.insert( data.end(), castleIT->mData, castleIT->mData + castleIT->mSize );
+		}
+
+		index.push_back( entry );
+	}
+
+	vector< byte > buffer( dataStart );
+
+	for( size_t i = 0; i < index.size(); ++i )
+		packEntryWrite( &buffer[ CASTLE_PACK_HEADER_SIZE + (i * CASTLE_PACK_ENTRY_SIZE) ], index[i] );
+
+	memcpy( &buffer[0], "CRPK", 4 );
+	packDwordWrite( &buffer[4], CASTLE_PACK_VERSION );
+	packDwordWrite( &buffer[8], (dword) index.size() );
+	packDwordWrite( &buffer[12], packHash( &buffer[0] + CASTLE_PACK_HEADER_SIZE, index.size() * CASTLE_PACK_ENTRY_SIZE ) );
+
+	buffer.insert( buffer.end(), data.begin(), data.end() );
+
+	return local_FileSave( pFilename, "castles", false, &buffer[0], buffer.size() );
+}
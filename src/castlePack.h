@@ -0,0 +1,76 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Castle Pack Archive
+ *  ------------------------------------------
+ */
+
+#define CASTLE_PACK_EXT			".cpk"
+#define CASTLE_PACK_VERSION		1
+#define CASTLE_PACK_NAME		16				// Longest C64 filename
+#define CASTLE_PACK_LENGTH_MAX	0x6802			// Largest castle, with its load address
+
+// File layout, all fields little-endian: header, the index sorted by name, then the castle data
+#define CASTLE_PACK_HEADER_SIZE	16				// "CRPK", version, entry count, FNV-1a of the index
+#define CASTLE_PACK_ENTRY_SIZE	(CASTLE_PACK_NAME + 20)
+
+enum eCastlePackFlags {
+	eCastlePackFlag_RLE		= 0x01				// Data is PackBits run-length encoded
+};
+
+// An index entry, as read from the pack
+struct sCastlePackEntry {
+	char			 mName[ CASTLE_PACK_NAME ];	// Filename on the original disk, zero padded
+	dword			 mOffset, mSize;			// Stored data
+	dword			 mLength;					// Size once unpacked
+	dword			 mChecksum;					// FNV-1a of the unpacked data
+	dword			 mFlags;					// eCastlePackFlags
+};
+
+// A castle to be written into a pack
+struct sCastlePackSource {
+	string			 mName;
+	const byte		*mData;
+	size_t			 mSize;
+};
+
+class cCastlePack {
+private:
+	string						 mFilename;
+	size_t						 mFileSize;
+
+	vector< sCastlePackEntry >	 mEntries;
+	dword						 mCount;
+	bool						 mReady;
+
+public:
+								 cCastlePack( string pFilename );
+
+	inline bool					 readyGet()	{ return mReady; }
+	inline dword				 countGet()	{ return mCount; }
+	inline string				 filenameGet() { return mFilename; }
+
+	const sCastlePackEntry		*entryGet( dword pIndex );
+	string						 nameGet( const sCastlePackEntry *pEntry );
+	byte						*extract( const sCastlePackEntry *pEntry, size_t &pSize );	// Unpack and check a castle, the caller owns the buffer
+
+	static bool					 write( string pFilename, vector< sCastlePackSource > &pCastles );
+};
@@ -0,0 +1,224 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Castle Library Watcher
+ *  ------------------------------------------
+ */
+
+#include "stdafx.h"
+#include "castleWatch.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
+static const char *gCastleWatchPaths[] = { "", "castles" };
+
+int cCastleWatch_WorkerThread( void *userdata ) {
+	cCastleWatch *watch = (cCastleWatch*) userdata;
+
+	return watch->workerThread();
+}
+
+cCastleWatch::cCastleWatch() {
+
+	mLock = SDL_CreateMutex();
+	mStop = SDL_CreateCond();
+	mRun = true;
+	mNotify = -1;
+
+#ifdef __linux__
+	mNotify = inotify_init();
+
+	if( mNotify >= 0 ) {
+		for( size_t i = 0; i < sizeof( gCastleWatchPaths ) / sizeof( gCastleWatchPaths[0] ); ++i ) {
+			string path = local_PathGenerate( "", gCastleWatchPaths[i], false );
+
+			int watch = inotify_add_watch( mNotify, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE );
+			if( watch >= 0 )
+				mWatches[ watch ] = gCastleWatchPaths[i];
+		}
+
+		// Nothing could be watched, look for changes instead
+		if( mWatches.empty() ) {
+			close( mNotify );
+			mNotify = -1;
+		}
+	}
+#endif
+
+	// Remember what is there now, so only later changes are reported
+	if( mNotify < 0 )
+		filesCompare( false );
+
+	mThread = SDL_CreateThread( cCastleWatch_WorkerThread, "creep castle watch", this );
+}
+
+cCastleWatch::~cCastleWatch() {
+
+	SDL_LockMutex( mLock );
+	mRun = false;
+	SDL_CondSignal( mStop );
+	SDL_UnlockMutex( mLock );
+
+	if( mThread )
+		SDL_WaitThread( mThread, 0 );
+
+#ifdef __linux__
+	if( mNotify >= 0 )
+		close( mNotify );
+#endif
+
+	SDL_DestroyCond( mStop );
+	SDL_DestroyMutex( mLock );
+}
+
+// Queue a changed file, once
+void cCastleWatch::changeAdd( string pPath, string pFilename ) {
+	vector< sCastleChange >::iterator changeIT;
+	sCastleChange change;
+
+	change.mPath = pPath;
+	change.mFilename = pFilename;
+
+	SDL_LockMutex( mLock );
+
+	for( changeIT = mChanges.begin(); changeIT != mChanges.end(); ++changeIT ) {
+		if( changeIT->mPath == pPath && changeIT->mFilename == pFilename )
+			break;
+	}
+
+	if( changeIT == mChanges.end() )
+		mChanges.push_back( change );
+
+	SDL_UnlockMutex( mLock );
+}
+
+bool cCastleWatch::changesGet( vector< sCastleChange > &pChanges ) {
+
+	SDL_LockMutex( mLock );
+
+	pChanges.insert( pChanges.end(), mChanges.begin(), mChanges.end() );
+	mChanges.clear();
+
+	SDL_UnlockMutex( mLock );
+
+	return !pChanges.empty();
+}
+
+// Compare the size and time of each file against the last look
+void cCastleWatch::filesCompare( bool pReport ) {
+	map< string, sCastleWatchFile >				 files;
+	map< string, sCastleWatchFile >::iterator	 fileIT, previousIT;
+	vector< string >::iterator					 nameIT;
+
+	for( size_t i = 0; i < sizeof( gCastleWatchPaths ) / sizeof( gCastleWatchPaths[0] ); ++i ) {
+		vector< string > names = directoryListTree( gCastleWatchPaths[i], "", false );
+
+		for( nameIT = names.begin(); nameIT != names.end(); ++nameIT ) {
+			sCastleWatchFile file;
+
+			// Sub folders are not part of the library
+			if( nameIT->find( '/' ) != string::npos )
+				continue;
+
+			if( !local_FileStat( *nameIT, gCastleWatchPaths[i], false, file.mSize, file.mTime ) )
+				continue;
+
+			files[ string( gCastleWatchPaths[i] ) + "/" + *nameIT ] = file;
+		}
+	}
+
+	if( pReport ) {
+		for( fileIT = files.begin(); fileIT != files.end(); ++fileIT ) {
+			previousIT = mFiles.find( fileIT->first );
+
+			if( previousIT == mFiles.end() || previousIT->second.mSize != fileIT->second.mSize || previousIT->second.mTime != fileIT->second.mTime ) {
+				size_t split = fileIT->first.find( '/' );
+
+				changeAdd( fileIT->first.substr( 0, split ), fileIT->first.substr( split + 1 ) );
+			}
+		}
+
+		for( previousIT = mFiles.begin(); previousIT != mFiles.end(); ++previousIT ) {
+
+			if( files.find( previousIT->first ) == files.end() ) {
+				size_t split = previousIT->first.find( '/' );
+
+				changeAdd( previousIT->first.substr( 0, split ), previousIT->first.substr( split + 1 ) );
+			}
+		}
+	}
+
+	mFiles.swap( files );
+}
+
+// Wait a short while for change notifications, and queue the files they name
+void cCastleWatch::notifyRead() {
+#ifdef __linux__
+	struct pollfd	 wait;
+	char			 buffer[ 4096 ] __attribute__(( aligned( __alignof__( struct inotify_event ) ) ));
+
+	wait.fd = mNotify;
+	wait.events = POLLIN;
+	wait.revents = 0;
+
+	if( poll( &wait, 1, CASTLE_WATCH_WAKE ) <= 0 )
+		return;
+
+	ssize_t size = read( mNotify, buffer, sizeof( buffer ) );
+
+	for( ssize_t pos = 0; pos + (ssize_t) sizeof( struct inotify_event ) <= size; ) {
+		struct inotify_event *event = (struct inotify_event*) (buffer + pos);
+		map< int, string >::iterator watchIT = mWatches.find( event->wd );
+
+		if( event->len && watchIT != mWatches.end() && !(event->mask & IN_ISDIR) )
+			changeAdd( watchIT->second, event->name );
+
+		pos += sizeof( struct inotify_event ) + event->len;
+	}
+#endif
+}
+
+int cCastleWatch::workerThread() {
+
+	for(;;) {
+		SDL_LockMutex( mLock );
+
+		// Without notifications, look again after a while
+		if( mRun && mNotify < 0 )
+			SDL_CondWaitTimeout( mStop, mLock, CASTLE_WATCH_POLL );
+
+		bool run = mRun;
+		SDL_UnlockMutex( mLock );
+
+		if( !run )
+			break;
+
+		if( mNotify >= 0 )
+			notifyRead();
+		else
+			filesCompare( true );
+	}
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Castle Library Watcher
+ *  ------------------------------------------
+ */
+
+#define CASTLE_WATCH_POLL		2000			// Milliseconds between looking for changes, without change notifications
+#define CASTLE_WATCH_WAKE		250				// Milliseconds between checking if the watcher should stop
+
+struct sCastleChange {
+	string			 mPath;						// Data folder holding the file, "" or "castles"
+	string			 mFilename;
+};
+
+struct sCastleWatchFile {
+	size_t			 mSize;
+	dword			 mTime;
+};
+
+class cCastleWatch {
+private:
+	SDL_Thread							*mThread;
+	SDL_mutex							*mLock;
+	SDL_cond							*mStop;			// Signalled when the watcher is asked to stop
+	bool								 mRun;
+
+	vector< sCastleChange >				 mChanges;		// Seen since they were last taken
+	map< string, sCastleWatchFile >		 mFiles;		// Files found by the last look, when polling
+
+	int									 mNotify;		// inotify descriptor, or -1 when polling
+	map< int, string >					 mWatches;		// Folder of each inotify watch
+
+	void								 changeAdd( string pPath, string pFilename );
+	void								 filesCompare( bool pReport );	// Look for files changed since the last look
+	void								 notifyRead();					// Wait for change notifications
+
+public:
+										 cCastleWatch();
+										~cCastleWatch();
+
+	bool								 changesGet( vector< sCastleChange > &pChanges );	// Take the changes seen so far
+	int									 workerThread();
+};
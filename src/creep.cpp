@@ -32,7 +32,9 @@
 #include "castleManager.h"
 #include "creep.h"
 #include "sound/sound.h"
+#include "sound/audioStats.h"
 #include "builder.hpp"
+#include "broadphase.h"
 
 #include "debug.h"
 
@@ -41,6 +43,12 @@
 #include <io.h>
 #endif
 
+void cCreep_SaveComplete( void *pUserData, string pFilename, bool pResult ) {
+	cCreep *creep = (cCreep*) pUserData;
+
+	creep->gameSaveComplete( pFilename, pResult );
+}
+
 const unsigned char cCreep::mRoomIntroData[] = {
 
 	0x0A, 0x16, // eObjectIntroMultiDraw
@@ -118,6 +126,12 @@ cCreep::cCreep() {
 
 	mBuilder = 0;
 	mCastle = 0;
+
+	mBroadphase = new cBroadphase();
+	mLargeRooms = false;
+	mSpritesMax = MAX_SPRITES;
+	mObjectsMax = MAX_OBJECTS;
+	memset( mSpriteImagesFrame, 0, sizeof( mSpriteImagesFrame ) );
 	mJoyButtonState = 0xA0;
 
 	mMusicCurrent = "MUSIC0";
@@ -126,7 +140,19 @@ cCreep::cCreep() {
 	mMusicBufferSize = 0;
 
 	mMenuReturn = false;
-	mTicksPrevious = SDL_GetTicks();
+	mSaveFailed = false;
+	tickRateSet( TICK_RATE_PAL );
+
+	mLatencyMode = false;
+	mLatencyInput = 0;
+	mLatencyTotal = mLatencyCount = mLatencyMax = 0;
+
+	mSoundQuality = -1;
+	mSoundRate = SOUND_RATE_DEFAULT;
+	mSoundFrames = SOUND_FRAMES_DEFAULT;
+	mStatsMode = false;
+	mStatsTicks = 0;
+	mTickStalls = 0;
 	mTimer = 0;
 
 	mPlayerStatus[0] = mPlayerStatus[1] = false;
@@ -142,6 +168,20 @@ cCreep::~cCreep() {
 	delete mInput;
 	delete mDebug;
 	delete mBuilder;
+	delete mBroadphase;
+}
+
+void cCreep::largeRoomsSet( bool pEnabled ) {
+	mLargeRooms = pEnabled;
+
+	mSpritesMax = pEnabled ? MAX_SPRITES_EXTENDED : MAX_SPRITES;
+	mObjectsMax = pEnabled ? MAX_OBJECTS_EXTENDED : MAX_OBJECTS;
+
+	for( byte Y = 0; Y != mSpritesMax; ++Y )
+		mRoomSprites[Y].state = SPR_UNUSED;
+
+	mScreen->spriteCountSet( mSpritesMax );
+	mBroadphase->invalidate();
 }
 
 void cCreep::builderStart( int pStartLevel ) {
@@ -218,6 +258,8 @@ void cCreep::run( int pArgCount, char *pArgs[] ) {
 	int	playLevel = 0;
 	bool	playLevelSet = false;
 	bool	unlimited = false;
+	string	renderSource, renderFile;
+	string	packFile;
 
 	// Output console message
 	cout << "The Castles of Dr. Creep (" << VERSION << ")" << endl << endl;
@@ -238,9 +280,67 @@ void cCreep::run( int pArgCount, char *pArgs[] ) {
 		if( arg == "-l" )
 			playLevelSet = true;
 
+		if( arg == "-i" ) {
+			cout << " Input latency reporting enabled." << endl;
+			mLatencyMode = true;
+			consoleShow = true;
+		}
+
+		if( arg == "-s" ) {
+			cout << " Frame and audio statistics enabled." << endl;
+			mStatsMode = true;
+			consoleShow = true;
+		}
+
+		if( arg == "-n" ) {
+			cout << " NTSC timing enabled." << endl;
+			tickRateSet( TICK_RATE_NTSC );
+		}
+
+		if( arg == "-x" ) {
+			cout << " Large rooms enabled." << endl;
+			largeRoomsSet( true );
+		}
+
+		if( arg == "-b" ) {
+			cSound::sidBenchmark();
+			return;
+		}
+
+		if( arg == "-w" && count + 2 < pArgCount ) {
+			renderSource = pArgs[count + 1];
+			renderFile = pArgs[count + 2];
+		}
+
+		if( arg == "-p" && count + 1 < pArgCount )
+			packFile = pArgs[count + 1];
+
+		if( arg == "-r" && count + 1 < pArgCount )
+			mSoundRate = max( 8000, atoi( pArgs[count + 1] ) );
+
+		if( arg == "-a" && count + 1 < pArgCount )
+			mSoundFrames = max( SOUND_FRAMES_MIN, min( atoi( pArgs[count + 1] ), SOUND_FRAMES_MAX ) );
+
+		if( arg == "-q" && count + 1 < pArgCount ) {
+			mSoundQuality = max( 0, min( atoi( pArgs[count + 1] ), (int) eSoundQuality_Max ) );
+			cout << " SID quality fixed at " << mSoundQuality << "." << endl;
+		}
+
 		++count;
 	}
 
+	// Render to a WAV and exit
+	if( renderFile.size() ) {
+		soundRender( renderSource, renderFile );
+		return;
+	}
+
+	// Pack every castle found into one archive and exit
+	if( packFile.size() ) {
+		mCastleManager->castlePackCreate( packFile );
+		return;
+	}
+
 	// Level selection was requested
 	if(playLevelSet) {
 		mCastleManager->castleListDisplay();
@@ -277,6 +377,13 @@ void cCreep::run( int pArgCount, char *pArgs[] ) {
 	start( playLevel, unlimited );
 }
 
+void cCreep::tickRateSet( byte pRate ) {
+	mTickRate = pRate;
+
+	mTickPeriod = SDL_GetPerformanceFrequency() / pRate;
+	mTickNext = SDL_GetPerformanceCounter();
+}
+
 void cCreep::interruptWait( byte pCount) {
 	// Screen Refresh occurs 50 times per second on a PAL C64
 	// and 60 times on an NTSC
@@ -284,22 +391,29 @@ void cCreep::interruptWait( byte pCount) {
 	// 0.01666666666666666666666666666667 seconds on an NTSC C64
 	// and 0.02 seconds on a PAL C64
 
-	double diffMil = (SDL_GetTicks() - mTicksPrevious);
-	double	sleepTime = 20;	// Milliseconds
+	// Interrupts fire on a fixed schedule, so the time spent executing the logic
+	// and presenting (which blocks with vsync) comes out of the wait, rather than adding to it
+	Uint64 now = SDL_GetPerformanceCounter();
 
-	if( diffMil > sleepTime) 
-		sleepTime -= diffMil;
-
-	if( sleepTime < 0 ) {
-		if(sleepTime < -20 )
-			sleepTime = 0;
-		else 
-			sleepTime = -sleepTime;
+	// Too far behind (window drag, breakpoint, slow present), drop the backlog rather than racing through it
+	if( now > mTickNext + (mTickPeriod * TICK_CATCHUP_MAX) ) {
+		mTickNext = now;
+		++mTickStalls;
 	}
 
-	Sleep( (dword) sleepTime * pCount );
+	mTickNext += mTickPeriod * pCount;
 
-	mTicksPrevious = SDL_GetTicks();
+	while( now < mTickNext ) {
+		Uint64 remaining = ((mTickNext - now) * 1000) / SDL_GetPerformanceFrequency();
+
+		// Sleep until the final millisecond, then yield until the deadline
+		if( remaining > 1 ) {
+			Sleep( (dword) (remaining - 1) );
+		} else
+			SDL_Delay( 0 );
+
+		now = SDL_GetPerformanceCounter();
+	}
 }
 
 //08C2
@@ -315,8 +429,13 @@ void cCreep::start( int pStartLevel, bool pUnlimited ) {
 	if(pUnlimited)
 		mUnlimitedLives = 0xFF;
 
-	if(!mSound)
-		mSound = new cSound( this );
+	if(!mSound) {
+		mSound = new cSound( this, true, mSoundRate, mSoundFrames );
+		soundQualityApply();
+
+		if( mSound->deviceOpen() )
+			soundEffectBankBuild();
+	}
 
 	for( count = 0xC8; ;) {
 		
@@ -475,6 +594,27 @@ void cCreep::optionsMenuPrepare() {
 		mMemory[ byte_30 + Y ] |= 0x80;
 	}
 
+	mMenuCastlesPtr = mFileListingNamePtr;
+
+	optionsMenuCastlesPrepare();
+	DisableSpritesAndStopSound();
+}
+
+void cCreep::optionsMenuCastlesPrepare() {
+	word byte_30;
+	byte A;
+
+	// Clear any names already listed
+	for( byte row = 0x0C; row < 0x18; ++row ) {
+		byte_30 = mMemory[ 0x5CE6 + row ];
+		byte_30 |= (mMemory[ 0x5D06 + row ] + 4) << 8;
+
+		for( byte Y = 0; Y < 0x28; ++Y )
+			mMemory[ byte_30 + Y ] = 0x20;
+	}
+
+	mFileListingNamePtr = mMenuCastlesPtr;
+
 	mMemory[ 0x775F ] = 0x0C;
 	mMemory[ 0x775E ] = 0x03;
 
@@ -529,7 +669,6 @@ void cCreep::optionsMenuPrepare() {
 	mMemory[ 0x239A ] = mFileListingNamePtr - 4;
 
 	mFileListingNamePtr = 0x08;
-	DisableSpritesAndStopSound();
 }
 
 // 268F: 
@@ -638,7 +777,13 @@ void cCreep::DisableSpritesAndStopSound() {
 
 	interruptWait( 2 );
 
+	if( mSound )
+		mSound->lock();
+
 	mPlayingSound = -1;
+
+	if( mSound )
+		mSound->unlock();
 }
 
 // 0B84
@@ -672,13 +817,14 @@ void cCreep::screenClear() {
 	for( word word_30 = 0xFFFF; word_30 >= 0xE000; --word_30 )
 		mMemory[ word_30 ] = 0;
 
-	for( byte Y = 0; Y != MAX_SPRITES; ++Y )
+	for( byte Y = 0; Y != mSpritesMax; ++Y )
 		mRoomSprites[Y].state = SPR_UNUSED;
 
 	for( word word_30 = 0xC000; word_30 < 0xC800; word_30++ ) 
 		mMemory[word_30] = 0;
 	
 	mObjectCount = 0;
+	mBroadphase->invalidate();
 	mScreen->bitmapRedrawSet();
 }
 
@@ -706,6 +852,9 @@ void cCreep::roomLoad() {
 		A = mMemory[ 0x7809 + X ];
 
 	roomPtrSet( A );
+
+	if( mStatsMode )
+		cout << std::dec << "[" << SDL_GetTicks() << "ms] Room " << (int) A << " load" << endl;
 	
 	// Room Color
 	roomSetColours( mMemory[mRoomPtr] & 0xF );
@@ -888,6 +1037,8 @@ bool cCreep::Intro() {
 		
 		mMenuScreenTimer &= 3;
 
+		gameSaveErrorShow();
+
 		if( mMenuScreenTimer != 0 ) {
 			++mMenuScreenCount;
 			roomPtrSet( mMenuScreenCount );
@@ -974,6 +1125,8 @@ bool cCreep::Intro() {
 	} while( !mJoyButtonState );
 
 	// 0CDD
+	mSound->lock();
+
 	mMusicPlaying = 0;
 	mIntro = false;
 	mMusicBuffer = 0;
@@ -988,6 +1141,8 @@ bool cCreep::Intro() {
 		mSound->sidWrite(0x04 + X, mMemory[ 0x20EF + X ]);
 	}
 
+	mSound->unlock();
+
 	eventProcess( true );
 	return false;
 }
@@ -1161,6 +1316,8 @@ musicUpdate:;
 		mMusicBuffer = 0;
 		
 	} else {
+		mSound->musicCacheEnd();
+
 		mMusicBuffer = mMusicBufferStart;
 		mMemory[ 0x20DD ] = 0x02;
 		
@@ -1172,6 +1329,86 @@ musicUpdate:;
 	return true;
 }
 
+// Pin the SID quality, if the user picked one
+void cCreep::soundQualityApply() {
+
+	if( mSoundQuality >= 0 )
+		mSound->qualitySet( (eSoundQuality) mSoundQuality, true );
+}
+
+// Render every sound effect through the sequencer once, for the mixer
+void cCreep::soundEffectBankBuild() {
+	cSound *live = mSound;
+
+	// Stop the audio thread sequencing while the sequencer is borrowed
+	live->lock();
+
+	for( byte effect = SOUND_LASER_FIRED; effect <= SOUND_KEY_PICKUP; ++effect ) {
+		vector< short > samples;
+
+		// A fresh SID for each effect, so none carries on from the last
+		mSound = new cSound( this, false, live->sampleRateGet() );
+		mSound->qualitySet( mSoundQuality >= 0 ? (eSoundQuality) mSoundQuality : eSoundQuality_Filter, true );
+
+		mPlayingSound = -1;
+		sound_EffectSequence( effect );
+		mSound->effectRender( samples );
+
+		live->effectBankSet( effect, samples );
+
+		delete mSound;
+	}
+
+	mSound = live;
+	mMusicBuffer = 0;
+	mPlayingSound = -1;
+
+	mSound->effectBankReady();
+	mSound->unlock();
+}
+
+// Render a music file (MUSICn), or a sound effect number, to a WAV without using the audio device
+bool cCreep::soundRender( string pSource, string pFile ) {
+	size_t size = 0;
+
+	if( !mSound ) {
+		mSound = new cSound( this, false, mSoundRate );
+		soundQualityApply();
+	}
+
+	// Play once, as in game
+	mIntro = false;
+	mPlayingSound = -1;
+
+	if( pSource.size() == 6 && pSource.compare( 0, 5, "MUSIC" ) == 0 ) {
+
+		if( !mCastleManager->fileLoad( pSource, size ) ) {
+			cout << "Unable to load " << pSource << endl;
+			return false;
+		}
+
+		// musicChange loads the next music number
+		mMusicCurrent = pSource;
+		--mMusicCurrent[5];
+		musicChange();
+
+	} else {
+		int effect = atoi( pSource.c_str() );
+
+		if( pSource.empty() || effect < SOUND_LASER_FIRED || effect > SOUND_KEY_PICKUP ) {
+			cout << "Unknown sound " << pSource << ", expected MUSIC0-9 or an effect 0-" << SOUND_KEY_PICKUP << endl;
+			return false;
+		}
+
+		sound_PlayEffect( (char) effect );
+	}
+
+	cout << "Rendering " << pSource << " to " << pFile << endl;
+
+	// Nothing in the game plays for this long
+	return mSound->waveRender( pFile, 600 );
+}
+
 // C49 : Music Change
 void cCreep::musicChange() {
 	byte*						MusicPtr = 0;
@@ -1188,9 +1425,18 @@ void cCreep::musicChange() {
 			mMusicCurrent[5] = '0';
 	};
 
+	// The audio thread is sequencing the old music
+	mSound->lock();
+
 	mMusicBuffer = MusicPtr + 4;		// Skip PRG load address, and the first 2 bytes of the real-data
 	mMusicBufferStart = mMusicBuffer;
 
+	// The intro music loops, and can be played from (or recorded into) the pre-rendered cache
+	if( mIntro )
+		mSound->musicCacheStart( mMusicCurrent, MusicPtr, mMusicBufferSize );
+	else
+		mSound->musicCacheStop();
+
 	byte A = 0;
 
 	//0C9A
@@ -1214,6 +1460,7 @@ void cCreep::musicChange() {
 	mTimerSet((0x14 << 2) | 3);
 
 	mSound->playback( true );
+	mSound->unlock();
 }
 
 // 0x2233 : Intro Menu
@@ -1241,6 +1488,27 @@ s2238:
 			hw_Update();
 			hw_IntSleep(1);
 
+			// Castles were added, changed or removed, relist them and return the cursor to the top
+			if( mCastleManager->castlesReload( mMusicBufferStart ) ) {
+				byte X = mFileListingNamePtr;
+				byte Y = mMemory[ 0xBA01 + X ];
+
+				word_30 = mMemory[ 0x5CE6 + Y ];
+				word_30 += (mMemory[ 0x5D06 + Y ] + 4) << 8;
+				mMemory[ word_30 + mMemory[ 0xBA00 + X ] - 2 ] = 0x20;
+
+				optionsMenuCastlesPrepare();
+
+				X = mFileListingNamePtr;
+				Y = mMemory[ 0xBA01 + X ];
+
+				word_30 = mMemory[ 0x5CE6 + Y ];
+				word_30 += (mMemory[ 0x5D06 + Y ] + 4) << 8;
+				mMemory[ word_30 + mMemory[ 0xBA00 + X ] - 2 ] = 0x3E;
+
+				goto s2238;
+			}
+
             // Check for input
 			KeyboardJoystickMonitor(0);
 
@@ -1481,6 +1749,9 @@ void cCreep::events_Execute() {
 	// 2E1D
 	interruptWait( 2 );
 
+	// Sample the input at the last moment before the logic runs
+	eventProcess( false );
+
 	// Get collisions from the hardware, and set them in the objects
 	Sprite_Collision_Set();
 
@@ -1542,7 +1813,10 @@ void cCreep::convertTimeToNumber( byte pA, byte pY ) {
 
 // 2E37: 
 void cCreep::Sprite_Collision_Set() {
-	byte gfxSpriteCollision = 0, gfxBackgroundCollision = 0;
+	bool gfxSpriteCollision[ MAX_SPRITES_EXTENDED ], gfxBackgroundCollision[ MAX_SPRITES_EXTENDED ];
+
+	memset( gfxSpriteCollision, 0, sizeof( gfxSpriteCollision ) );
+	memset( gfxBackgroundCollision, 0, sizeof( gfxBackgroundCollision ) );
 
 	vector< sScreenPiece *>				*collisions = mScreen->collisionsGet();
 	vector< sScreenPiece *>::iterator	 colIT;
@@ -1552,44 +1826,45 @@ void cCreep::Sprite_Collision_Set() {
 
 		if( piece->mPriority == ePriority_Background || piece->mSprite2 == 0 ) {
 			// Background collision
-			gfxBackgroundCollision |= (1 << (piece->mSprite-1) );
+			gfxBackgroundCollision[ piece->mSprite - 1 ] = true;
 
 		} 
 		if( piece->mSprite2 ) {
 			// Sprite collision
-			gfxSpriteCollision |= (1 << (piece->mSprite-1) );
-			gfxSpriteCollision |= (1 << (piece->mSprite2-1) );
+			gfxSpriteCollision[ piece->mSprite - 1 ] = true;
+			gfxSpriteCollision[ piece->mSprite2 - 1 ] = true;
 		}
 
 	}
 
+	mSpriteCollisions.clear();
+
 	// loop each sprite, marking it with a collision, if one occured
-	for( byte spriteNumber = 0; spriteNumber != MAX_SPRITES; ++spriteNumber) {
+	for( byte spriteNumber = 0; spriteNumber != mSpritesMax; ++spriteNumber) {
 		
 		byte A = mRoomSprites[spriteNumber].state;
 		if( !(A & SPR_UNUSED) ) {
 
 			A &= 0xF9;
-			if( gfxSpriteCollision & 0x01 )
+			if( gfxSpriteCollision[ spriteNumber ] ) {
 				A |= SPR_COLLIDE_SPRITE;
+				mSpriteCollisions.push_back( spriteNumber );
+			}
 			
-			if( gfxBackgroundCollision & 0x01 )
+			if( gfxBackgroundCollision[ spriteNumber ] )
 				A |= SPR_COLLIDE_BACKGROUND;
 
 			mRoomSprites[spriteNumber].state = A;
 		}
-
-		gfxSpriteCollision >>= 1;
-		gfxBackgroundCollision >>= 1;
 	}
 }
 
 // 2E79: Execute any objects with actions / collisions, enable their sprites
 void cCreep::Sprite_Execute( ) {
-	byte  A;
+	byte  A, spriteX, msb;
 	byte w30 = 0;
 
-	for(byte spriteNumber = 0 ; spriteNumber < MAX_SPRITES; ++spriteNumber ) {
+	for(byte spriteNumber = 0 ; spriteNumber < mSpritesMax; ++spriteNumber ) {
 
 		A = mRoomSprites[spriteNumber].state;
 
@@ -1661,7 +1936,9 @@ s2ED5:
 				w30 = (word_30 & 0xFF00) >> 8;
 
 				// Sprite X
-				mMemory[ 0x10 + spriteNumber ] = (word_30 - 8);
+				spriteX = (word_30 - 8);
+				if( spriteNumber < MAX_SPRITES )
+					mMemory[ 0x10 + spriteNumber ] = spriteX;
 				sprite->mX = (word_30 - 8);
 
 				if((word_30 >= 0x100) && ((word_30 - 8) < 0x100))
@@ -1673,16 +1950,22 @@ s2F51:;
 					sprite->_rEnabled = false;
 
 				} else {
-					if( w30 ) {
-						A = (mMemory[ 0x20 ] | mMemory[ 0x2F82 + spriteNumber ]);
+					// Sprites past the hardware eight have no X Bit 8 register
+					msb = 0xFF;
+					if( spriteNumber < MAX_SPRITES ) {
+						if( w30 ) {
+							A = (mMemory[ 0x20 ] | mMemory[ 0x2F82 + spriteNumber ]);
+						} else
+							A = (mMemory[ 0x2F82 ] ^ 0xFF) & mMemory[ 0x20 ];
+
+						// Sprites X Bit 8
+						mMemory[ 0x20 ] = A;
+						msb = mMemory[ 0x2F82 + spriteNumber ];
 					} else
-						A = (mMemory[ 0x2F82 ] ^ 0xFF) & mMemory[ 0x20 ];
-
-					// Sprites X Bit 8
-					mMemory[ 0x20 ] = A;
+						A = 0xFF;
 
 					// 2F45
-					if((A & mMemory[ 0x2F82 + spriteNumber ]) && (mMemory[ 0x10 + spriteNumber ] >= 0x58) && w30 ) {
+					if((A & msb) && (spriteX >= 0x58) && w30 ) {
 						sprite->_rEnabled = false;
 					} else {
 						// 2F5B
@@ -1723,7 +2006,31 @@ void cCreep::Sprite_Object_Collision_Check( byte pSpriteNumber ) {
 	if( !mObjectCount )
 		return;
 
-	for( byte ObjectNumber = 0; ObjectNumber < mObjectCount; ++ObjectNumber ) {
+	// Large rooms only visit the objects sharing a grid cell with the sprite
+	size_t candidate = 0;
+	bool   query = true;
+
+	for( byte ObjectNumber = 0; ; ++ObjectNumber ) {
+
+		if( mLargeRooms ) {
+			// An object handler may have moved/resized an object, requery from the current position
+			if( query || mBroadphase->dirtyGet() ) {
+				if( mBroadphase->dirtyGet() )
+					mBroadphase->build( mRoomAnim, mObjectCount );
+
+				query = false;
+				mBroadphase->query( SpriteX_Start, SpriteY_Start, SpriteX_Finish, SpriteY_Finish, mObjectCandidates );
+				candidate = lower_bound( mObjectCandidates.begin(), mObjectCandidates.end(), ObjectNumber ) - mObjectCandidates.begin();
+			}
+
+			if( candidate == mObjectCandidates.size() )
+				break;
+
+			ObjectNumber = mObjectCandidates[ candidate++ ];
+		}
+
+		if( ObjectNumber >= mObjectCount )
+			break;
 
 		if( !(mRoomAnim[ObjectNumber].mFlags & ITM_DISABLE ))
 			if( !(SpriteX_Finish < mRoomAnim[ObjectNumber].mX ))
@@ -1885,7 +2192,11 @@ void cCreep::Sprite_Collision_Check( byte pSpriteNumber ) {
 		if( (SpriteY + mRoomSprites[pSpriteNumber].mCollisionHeight) > 0x100 )
 			SpriteY = 0;
 
-		for(byte SpriteNumber = 0; SpriteNumber < MAX_SPRITES; ++SpriteNumber ) {
+		// Large rooms only visit the sprites flagged by the last collision pass
+		size_t total = mLargeRooms ? mSpriteCollisions.size() : MAX_SPRITES;
+
+		for( size_t count = 0; count < total; ++count ) {
+			byte SpriteNumber = mLargeRooms ? mSpriteCollisions[ count ] : (byte) count;
 
 			// 3068
 			if( pSpriteNumber == SpriteNumber )
@@ -2759,6 +3070,7 @@ void cCreep::object_Execute() {
 
 			// Decrease object count
 			--mObjectCount;
+			mBroadphase->invalidate();
 
 			// Last object? then nothing to do
 			if( X == mObjectCount )
@@ -3111,11 +3423,22 @@ void cCreep::mapArrowDraw( byte pPlayer ) {
 bool cCreep::mapDisplay() {
 	byte gfxPosX, gfxPosY;
 
+	gameSaveErrorShow();
 	screenClear();
 	
 	Sleep(300);
 	eventProcess( true );
 
+	// Mark the players rooms as visible, and bring the map up to date
+	for( byte X = 0; X < 2; ++X ) {
+		if( mPlayerStatus[X] == 1 ) {
+			roomPtrSet( mMemory[ 0x7809 + X ] );
+			mMemory[ mRoomPtr ] |= MAP_ROOM_VISIBLE;
+		}
+	}
+
+	mapRoomsUpdate();
+
 	// Draw both players Name/Time/Arrows
 	// FA9
 	for(mMemory[ 0x11D7 ] = 0 ; mMemory[ 0x11D7 ] != 2; ++mMemory[ 0x11D7 ] ) {
@@ -3164,8 +3487,6 @@ bool cCreep::mapDisplay() {
 	}
 	
 	// 1094
-	mapRoomDraw();
-
 	mMemory[ 0x11CB ] = 0;
 	mMemory[ 0x11CD ] = mMemory[ 0x11CC ] = 1;
 	if( mPlayerStatus[0] != 1 ) {
@@ -3597,6 +3918,9 @@ void cCreep::screenDraw( word pDecodeMode, word pGfxID, byte pGfxPosX, byte pGfx
 	byte drawingFirst = 0;
 	byte byte_5CE2;
 
+	byte gfxColumns = 0;
+	bool gfxColumnsWrap = false;
+
 	mScreen->bitmapRedrawSet();
 
 	if( pDecodeMode	!= 0 ) {
@@ -3676,7 +4000,14 @@ void cCreep::screenDraw( word pDecodeMode, word pGfxID, byte pGfxPosX, byte pGfx
 		//592C
 		gfxPosRightX = gfxDestX2 + mGfxWidth;
 		--gfxPosRightX;
-		
+
+		// Resolve the columns which land on screen once, rather than for each byte.
+		// Graphics wrapping past the left edge keep the original bitmap column walk
+		gfxColumnsWrap = (gfxDestX2 > gfxPosRightX) || !mGfxWidth;
+		gfxColumns = 0;
+		if( gfxDestX2 <= gfxPosRightX && gfxDestX2 < 0x28 )
+			gfxColumns = min( gfxPosRightX + 1, 0x28 ) - gfxDestX2;
+
 		Counter2 = 0;
 
 		word_32 += 3;
@@ -3889,17 +4220,26 @@ s5AED:;
 				byte_36 = byte_34 +  (mGfxEdgeOfScreenX << 8);
 				byte_36 += gfxDestX;
 
-				for( byte Y = 0; ; ++Y ) {
-					// 5B2E
-					if( gfxCurPos < 0x28 )
-						mMemory[ byte_36 + Y ] |= mMemory[ word_32 + Y ];
+				if( !gfxColumnsWrap ) {
+					// Each column is a character cell (8 bytes) further along the bitmap
+					byte *dest = &mMemory[ byte_36 ], *source = &mMemory[ word_32 ];
 
-					if( gfxCurPos == gfxPosRightX )
-						break;
+					for( byte Y = 0; Y < gfxColumns; ++Y )
+						dest[ Y << 3 ] |= source[ Y ];
 
-					//5B43
-					byte_36 += 7;
-					++gfxCurPos;
+				} else {
+					for( byte Y = 0; ; ++Y ) {
+						// 5B2E
+						if( gfxCurPos < 0x28 )
+							mMemory[ byte_36 + Y ] |= mMemory[ word_32 + Y ];
+
+						if( gfxCurPos == gfxPosRightX )
+							break;
+
+						//5B43
+						byte_36 += 7;
+						++gfxCurPos;
+					}
 				}
 			}
 
@@ -3937,19 +4277,11 @@ noCarry2:;
 	word_30 = videoPtr0;
 	word_30 += (0xCC + videoPtr1) << 8;
 
-	byte Y = 0;
-
 	// 5BBC
 	for( ;; ) {
 
-		if( gfxCurrentPosY < 0x19 ) {
-			
-			for( Y = 0, gfxCurPos = gfxDestX2; gfxCurPos <= gfxPosRightX; ++gfxCurPos, ++Y ) {
-			
-				if( gfxCurPos < 0x28 )
-					mMemory[ word_30 + Y ] = mMemory[ word_32 + Y ];
-			}
-		}
+		if( gfxCurrentPosY < 0x19 )
+			memcpy( &mMemory[ word_30 ], &mMemory[ word_32 ], gfxColumns );
 
 		// 5BE5
 		if( gfxCurrentPosY != byte_5CE2 ) {
@@ -3987,14 +4319,8 @@ noCarry2:;
 	// 5C56
 	for( ;; ) {
 		
-		if( gfxCurrentPosY < 0x19 ) {
-
-			for(Y = 0, gfxCurPos = gfxDestX2; gfxCurPos <= gfxPosRightX; ++gfxCurPos, ++Y) {
-
-				if( gfxCurPos < 0x28 ) 
-					mMemory[ word_30 + Y ] = mMemory[ word_32 + Y ];
-			}
-		}
+		if( gfxCurrentPosY < 0x19 )
+			memcpy( &mMemory[ word_30 ], &mMemory[ word_32 ], gfxColumns );
 		//5C7F
 		if( gfxCurrentPosY != byte_5CE2 ) {
 			++gfxCurrentPosY;
@@ -4016,13 +4342,8 @@ noCarry2:;
 
 // 1203: 
 void cCreep::mapRoomDraw() {
-	byte byte_13EA, roomX;
-	byte roomY, roomHeight, roomWidth;
 
 	mRoomPtr = 0x7900;
-	
-	byte gfxPosX;
-	byte gfxPosY;
 
 	//1210
 	for(;;) {
@@ -4030,133 +4351,196 @@ void cCreep::mapRoomDraw() {
 		if( mMemory[ mRoomPtr ] & MAP_ROOM_STOP_DRAW )
 			return;
 		
-		if( mMemory[ mRoomPtr ] & MAP_ROOM_VISIBLE ) {
-			//1224
-			
-			mMemory[ 0x63E7 ] = mMemory[ mRoomPtr ] & 0xF;		// color
-			roomX		= mMemory[ mRoomPtr + 1 ];				// top left x
-			roomY		= mMemory[ mRoomPtr + 2 ];				// top left y
-			roomWidth	= mMemory[ mRoomPtr + 3 ] & 7;			// width
-			roomHeight	= (mMemory[ mRoomPtr + 3 ] >> 3) & 7;	// height
+		if( mMemory[ mRoomPtr ] & MAP_ROOM_VISIBLE )
+			mapRoomDrawSingle();
 
-			gfxPosY = roomY;
-			
-			// Draw Room Floor Square
-			// 1260
-			for( byte CurrentX = roomWidth; CurrentX ; --CurrentX) {
-				
-				gfxPosX = roomX;
-				
-				for(byte_13EA = roomHeight; byte_13EA; --byte_13EA) {
-					screenDraw( 0, 0x0A, gfxPosX, gfxPosY, 0 );
-					gfxPosX += 0x04;
-				}
+		//134E
+		mRoomPtr += 0x08;
+	}
+}
 
-				gfxPosY += 0x08;
-			}
+// Restore the map from the cache, drawing only the rooms which became visible since.
+// The map is drawn again from scratch when the rooms or doors differ (another castle),
+// or a room has been hidden again (a new game or a loaded position)
+void cCreep::mapRoomsUpdate() {
+	vector< byte > layout, visible;
+	bool rebuild;
 
-			// 128B
-			// Top edge of room
-			mTxtX_0 = roomX;
-			mTxtY_0 = roomY;
-			
+	for( mRoomPtr = 0x7900; !(mMemory[ mRoomPtr ] & MAP_ROOM_STOP_DRAW); mRoomPtr += 0x08 ) {
+		byte doors = sub_6009( 0 );
 
-			for( byte_13EA = roomHeight; byte_13EA; --byte_13EA) {
-				screenDraw(1, 0, 0, 0, 0x0B );
-				mTxtX_0 += 0x04;
-			}
+		visible.push_back( mMemory[ mRoomPtr ] & MAP_ROOM_VISIBLE );
 
-			// 12B8
-			// Bottom edge of room
-			mTxtX_0 = roomX;
-			mTxtY_0 = ((roomWidth << 3) + roomY) - 3;
+		layout.push_back( mMemory[ mRoomPtr ] & ~MAP_ROOM_VISIBLE );
+		layout.insert( layout.end(), &mMemory[ mRoomPtr + 1 ], &mMemory[ mRoomPtr + 8 ] );
 
-			for( byte_13EA = roomHeight; byte_13EA; --byte_13EA) {
-				screenDraw(1, 0, 0, 0, 0x0B );
-				mTxtX_0 += 0x04;
-			}
+		// Door count, then 8 bytes per door
+		layout.insert( layout.end(), &mMemory[ word_40 - 1 ], &mMemory[ word_40 + (doors << 3) ] );
+	}
 
-			//12E5
-			// Draw Left Edge
-			mTxtX_0 = roomX;
-			mTxtY_0 = roomY;
+	rebuild = !mMapCache.mValid || layout != mMapCache.mLayout;
 
-			for( byte_13EA = roomWidth; byte_13EA; --byte_13EA) {
-				screenDraw(1, 0, 0, 0, 0x0C );
-				mTxtY_0 += 0x08;
-			}
+	for( size_t room = 0; !rebuild && room < visible.size(); ++room ) {
+		if( mMapCache.mVisible[ room ] && !visible[ room ] )
+			rebuild = true;
+	}
 
-			//130D
-			// Draw Right Edge
-			mTxtX_0 = ((roomHeight << 2) + roomX) - 4;
-			mTxtY_0 = roomY;
+	if( rebuild ) {
+		// The screen has just been cleared
+		mMapCache.mLayout = layout;
+		mMapCache.mVisible.assign( visible.size(), 0 );
+	} else {
+		memcpy( &mMemory[ 0xE000 ], mMapCache.mBitmap, sizeof( mMapCache.mBitmap ) );
+		memcpy( &mMemory[ 0xCC00 ], mMapCache.mScreen, sizeof( mMapCache.mScreen ) );
+		memcpy( &mMemory[ 0xD800 ], mMapCache.mColor, sizeof( mMapCache.mColor ) );
+		mScreen->bitmapRedrawSet();
+	}
 
-			for( byte_13EA = roomWidth; byte_13EA; --byte_13EA) {
-				screenDraw(1, 0, 0, 0, 0x0D );
-				mTxtY_0 += 0x08;
-			}
+	bool drawn = rebuild;
 
-			// 133E
-			byte_13EA = sub_6009( 0 );
-s1349:;
-			if( byte_13EA )
-				break;
-		} 
+	for( size_t room = 0; room < visible.size(); ++room ) {
+		if( !visible[ room ] || mMapCache.mVisible[ room ] )
+			continue;
 
-		//134E
-		mRoomPtr += 0x08;
+		mRoomPtr = (word) (0x7900 + (room << 3));
+		mapRoomDrawSingle();
+
+		mMapCache.mVisible[ room ] = visible[ room ];
+		drawn = true;
 	}
 
-	//135C
-	byte A = mMemory[ word_40 + 2 ];
-	A &= 3;
+	if( drawn ) {
+		memcpy( mMapCache.mBitmap, &mMemory[ 0xE000 ], sizeof( mMapCache.mBitmap ) );
+		memcpy( mMapCache.mScreen, &mMemory[ 0xCC00 ], sizeof( mMapCache.mScreen ) );
+		memcpy( mMapCache.mColor, &mMemory[ 0xD800 ], sizeof( mMapCache.mColor ) );
+	}
 
-	if( !( A & 3) ) {
-		mTxtY_0 = roomY;
-	} else {
-		// 136D
-		if( A == 2 ) {
-			// 136F
-			mTxtY_0 = (roomWidth << 3) + roomY;
-			mTxtY_0 -= 3;
+	mMapCache.mValid = true;
+}
+
+// Draw the room at mRoomPtr, and its doors
+void cCreep::mapRoomDrawSingle() {
+	byte byte_13EA, roomX;
+	byte roomY, roomHeight, roomWidth;
+	
+	byte gfxPosX;
+	byte gfxPosY;
+
+	//1224
+	mMemory[ 0x63E7 ] = mMemory[ mRoomPtr ] & 0xF;		// color
+	roomX		= mMemory[ mRoomPtr + 1 ];				// top left x
+	roomY		= mMemory[ mRoomPtr + 2 ];				// top left y
+	roomWidth	= mMemory[ mRoomPtr + 3 ] & 7;			// width
+	roomHeight	= (mMemory[ mRoomPtr + 3 ] >> 3) & 7;	// height
+
+	gfxPosY = roomY;
+	
+	// Draw Room Floor Square
+	// 1260
+	for( byte CurrentX = roomWidth; CurrentX ; --CurrentX) {
+		
+		gfxPosX = roomX;
+		
+		for(byte_13EA = roomHeight; byte_13EA; --byte_13EA) {
+			screenDraw( 0, 0x0A, gfxPosX, gfxPosY, 0 );
+			gfxPosX += 0x04;
+		}
+
+		gfxPosY += 0x08;
+	}
 
+	// 128B
+	// Top edge of room
+	mTxtX_0 = roomX;
+	mTxtY_0 = roomY;
+	
+
+	for( byte_13EA = roomHeight; byte_13EA; --byte_13EA) {
+		screenDraw(1, 0, 0, 0, 0x0B );
+		mTxtX_0 += 0x04;
+	}
+
+	// 12B8
+	// Bottom edge of room
+	mTxtX_0 = roomX;
+	mTxtY_0 = ((roomWidth << 3) + roomY) - 3;
+
+	for( byte_13EA = roomHeight; byte_13EA; --byte_13EA) {
+		screenDraw(1, 0, 0, 0, 0x0B );
+		mTxtX_0 += 0x04;
+	}
+
+	//12E5
+	// Draw Left Edge
+	mTxtX_0 = roomX;
+	mTxtY_0 = roomY;
+
+	for( byte_13EA = roomWidth; byte_13EA; --byte_13EA) {
+		screenDraw(1, 0, 0, 0, 0x0C );
+		mTxtY_0 += 0x08;
+	}
+
+	//130D
+	// Draw Right Edge
+	mTxtX_0 = ((roomHeight << 2) + roomX) - 4;
+	mTxtY_0 = roomY;
+
+	for( byte_13EA = roomWidth; byte_13EA; --byte_13EA) {
+		screenDraw(1, 0, 0, 0, 0x0D );
+		mTxtY_0 += 0x08;
+	}
+
+	// 133E
+	for( byte_13EA = sub_6009( 0 ); byte_13EA; --byte_13EA ) {
+
+		//135C
+		byte A = mMemory[ word_40 + 2 ];
+		A &= 3;
+
+		if( !( A & 3) ) {
+			mTxtY_0 = roomY;
 		} else {
-			// 13A0
-			mTxtY_0 = roomY + mMemory[ word_40 + 6 ];
-			
-			if( A != 3 ) {
-				mTxtX_0 = ((roomHeight << 2) + roomX) - 4;
-				A = 0x11;
+			// 136D
+			if( A == 2 ) {
+				// 136F
+				mTxtY_0 = (roomWidth << 3) + roomY;
+				mTxtY_0 -= 3;
+
 			} else {
-				// 13C5
-				mTxtX_0 = roomX;
-				A = 0x10;
-			}
+				// 13A0
+				mTxtY_0 = roomY + mMemory[ word_40 + 6 ];
+			
+				if( A != 3 ) {
+					mTxtX_0 = ((roomHeight << 2) + roomX) - 4;
+					A = 0x11;
+				} else {
+					// 13C5
+					mTxtX_0 = roomX;
+					A = 0x10;
+				}
 			
-			goto s13CD;
+				goto s13CD;
+			}
 		}
-	}
 
-	// 1381
-	mTxtX_0 = A = roomX + mMemory[ word_40 + 5 ];
+		// 1381
+		mTxtX_0 = A = roomX + mMemory[ word_40 + 5 ];
 
-	A &= 2;
+		A &= 2;
 	
-	if( A ) {
-		A ^= mTxtX_0;
-		mTxtX_0 = A;
-		A = 0x0F;
-	} else 
-		A = 0x0E;
+		if( A ) {
+			A ^= mTxtX_0;
+			mTxtX_0 = A;
+			A = 0x0F;
+		} else 
+			A = 0x0E;
 		
-	// Draw Doors in sides
+		// Draw Doors in sides
 s13CD:;
-	screenDraw( 1, 0, 0, 0, A );
-
-	word_40 += 0x08;
-	--byte_13EA;
-	goto s1349;
+		screenDraw( 1, 0, 0, 0, A );
 
+		word_40 += 0x08;
+	}
 }
 
 void cCreep::obj_Image_Draw() {
@@ -4234,13 +4618,13 @@ void cCreep::eventProcess( bool pResetKeys ) {
 		switch (EventIT->mType) {
 			case eEvent_KeyUp:
 			case eEvent_KeyDown:
-				mInput->inputCheck( pResetKeys, *EventIT );
-				break;
-
 			case eEvent_JoyButtonDown:
 			case eEvent_JoyButtonUp:
 			case eEvent_JoyMovement:
 				mInput->inputCheck( pResetKeys, *EventIT );
+
+				if( mLatencyMode && !mLatencyInput )
+					mLatencyInput = EventIT->mTimestamp ? EventIT->mTimestamp : SDL_GetTicks();
 				break;
 
 			case eEvent_MouseLeftDown:
@@ -4275,9 +4659,52 @@ void cCreep::eventProcess( bool pResetKeys ) {
 void cCreep::hw_Update() {
 
 	mScreen->refresh();
+	latencyPresented();
+	statsReport();
+
+	mCastleManager->savesPoll();
+
 	eventProcess( false );
 }
 
+// A frame has been presented, report how long the oldest input took to reach the screen
+void cCreep::latencyPresented() {
+	if( !mLatencyInput )
+		return;
+
+	dword latency = SDL_GetTicks() - mLatencyInput;
+	mLatencyInput = 0;
+
+	mLatencyTotal += latency;
+	++mLatencyCount;
+	if( latency > mLatencyMax )
+		mLatencyMax = latency;
+
+	cout << "Input latency: " << std::dec << latency << "ms";
+	cout << " (average " << (mLatencyTotal / mLatencyCount) << "ms, max " << mLatencyMax << "ms)" << endl;
+}
+
+// Report the frame timers and audio statistics every few seconds, stamped so glitches can be matched to room loads
+void cCreep::statsReport() {
+	if( !mStatsMode )
+		return;
+
+	dword ticks = SDL_GetTicks();
+	if( ticks - mStatsTicks < STATS_REPORT_SECONDS * 1000 )
+		return;
+
+	mStatsTicks = ticks;
+
+	cout << std::dec << "[" << ticks << "ms] Frames: " << mScreen->fpsGet() << " fps (average " << mScreen->fpsAverageGet() << ")";
+	cout << ", " << mTickStalls << " stalls" << endl;
+	mTickStalls = 0;
+
+	if( mSound ) {
+		cout << "[" << ticks << "ms] Audio: " << mSound->statsGet()->reportTake();
+		cout << ", quality " << mSound->qualityGet() << endl;
+	}
+}
+
 // 1935: Sleep for X amount of interrupts
 void cCreep::hw_IntSleep( byte pA ) {
 
@@ -4518,8 +4945,8 @@ s1BE7:;
 	mMemory[ 0x28D2 ] = mMemory[ 0xBA03 + X ];
 	mMemory[ 0x28D1 ] = 2;
 	
-	// Save highscores
-	mCastleManager->scoresSave( mCastle->nameGet(), readLEWord( &mMemory[ 0xB800 ] ), &mMemory[ 0xB800 ] );
+	// Save highscores, on the save worker
+	mCastleManager->scoresSaveQueue( mCastle->nameGet(), readLEWord( &mMemory[ 0xB800 ] ), &mMemory[ 0xB800 ], cCreep_SaveComplete, this );
 
 	DisableSpritesAndStopSound();
 }
@@ -4629,8 +5056,25 @@ void cCreep::sound_PlayEffect( char pA ) {
 	if( mDisableSoundEffects == 1 )
 		return;
 
-	if( mPlayingSound >= 0 )
+	// Pre-rendered, mix it straight over the music
+	if( mSound->effectsReady() ) {
+		mSound->effectPlay( pA );
+		return;
+	}
+
+	sound_EffectSequence( pA );
+}
+
+// Start the sequencer on an effect, it plays through the SID in place of the music
+void cCreep::sound_EffectSequence( char pA ) {
+
+	// The audio thread sequences the effect
+	mSound->lock();
+
+	if( mPlayingSound >= 0 ) {
+		mSound->unlock();
 		return;
+	}
 
 	mPlayingSound = pA;
 
@@ -4657,6 +5101,7 @@ void cCreep::sound_PlayEffect( char pA ) {
 	mMemory[ 0xDC0E ] = 0x01;
 
 	mSound->playback(true);
+	mSound->unlock();
 }
 
 void cCreep::obj_Walkway_Prepare() {
@@ -4807,10 +5252,7 @@ void cCreep::hw_SpritePrepare( byte pSpriteNumber ) {
 	mRoomSprites[pSpriteNumber].mCollisionHeight = mMemory[ word_30 + 1 ];
 	
 	// 5D72
-	
-	word_32 = mMemory[ 0x26 + pSpriteNumber ] ^ 8;
-	word_32 <<= 6;
-	word_32 += 0xC000;
+	byte *spriteData = hw_SpriteBufferGet( pSpriteNumber );
 
 	word_30 += 0x03;
 	tmpHeight = 0;
@@ -4825,7 +5267,7 @@ void cCreep::hw_SpritePrepare( byte pSpriteNumber ) {
 			else
 				A = 0;
 
-			mMemory[ word_32 + Y ] = A;
+			spriteData[ Y ] = A;
 		}
 
 		++tmpHeight;
@@ -4838,17 +5280,13 @@ void cCreep::hw_SpritePrepare( byte pSpriteNumber ) {
 			word_30 = 0x5E89;
 		
 		// 5DED
-		word_32 += 0x03;
+		spriteData += 0x03;
 	}
 
 	// 5DFB
 	cSprite *sprite = mScreen->spriteGet(pSpriteNumber);
 
-	word dataSrc = mMemory[ 0x26 + pSpriteNumber ] ^ 8;
-	dataSrc <<= 6;
-	dataSrc += 0xC000;
-
-	mMemory[ 0x26 + pSpriteNumber ] = mMemory[ 0x26 + pSpriteNumber ] ^ 8;
+	byte *dataSrc = hw_SpriteBufferFlip( pSpriteNumber );
 
 	// Sprite Color
 	sprite->_color = mRoomSprites[pSpriteNumber].spriteFlags & 0x0F;
@@ -4883,10 +5321,39 @@ void cCreep::hw_SpritePrepare( byte pSpriteNumber ) {
 		sprite->_rMultiColored = false;
 	}
 
-	sprite->streamLoad( &mMemory[ dataSrc ] );
+	sprite->streamLoad( dataSrc );
 	mScreen->spriteRedrawSet();
 }
 
+// Buffer which the next image of a sprite is written into
+byte *cCreep::hw_SpriteBufferGet( byte pSpriteNumber ) {
+
+	if( pSpriteNumber >= MAX_SPRITES ) {
+		byte slot = pSpriteNumber - MAX_SPRITES;
+
+		return mSpriteImages[ slot ][ mSpriteImagesFrame[ slot ] ^ 1 ];
+	}
+
+	word_32 = mMemory[ 0x26 + pSpriteNumber ] ^ 8;
+	word_32 <<= 6;
+	word_32 += 0xC000;
+
+	return &mMemory[ word_32 ];
+}
+
+// Swap the displayed buffer of a sprite, returning the new image
+byte *cCreep::hw_SpriteBufferFlip( byte pSpriteNumber ) {
+	byte *data = hw_SpriteBufferGet( pSpriteNumber );
+
+	// Sprites past the hardware eight have no sprite pointer in the C64 memory
+	if( pSpriteNumber >= MAX_SPRITES )
+		mSpriteImagesFrame[ pSpriteNumber - MAX_SPRITES ] ^= 1;
+	else
+		mMemory[ 0x26 + pSpriteNumber ] = mMemory[ 0x26 + pSpriteNumber ] ^ 8;
+
+	return data;
+}
+
 void cCreep::stringSet( byte pPosX, byte pPosY, byte pColor, string pMessage ) {
 	memcpy( &mMemory[ 0xB906 ], pMessage.c_str(), pMessage.size() );
  
@@ -4964,24 +5431,45 @@ void cCreep::gamePositionSave( bool pCastleSave ) {
 	if( pCastleSave )
 		filename.insert(0, "Z" );
 
-	bool result = false;
-
+	// The save worker takes a copy, and writes it while we carry on
 	if( pCastleSave )
-		result = mCastleManager->castleSave( filename, saveSize, &mMemory[ 0x7800 ] );
+		mCastleManager->castleSaveQueue( filename, saveSize, &mMemory[ 0x7800 ], cCreep_SaveComplete, this );
 	else
-		result = mCastleManager->positionSave( filename, saveSize, &mMemory[ 0x7800 ] );
+		mCastleManager->positionSaveQueue( filename, saveSize, &mMemory[ 0x7800 ], cCreep_SaveComplete, this );
 
-	if( result == false) {
+	DisableSpritesAndStopSound();
+}
 
-		mObjectPtr = 0x25AA;	// IO ERROR
-		screenClear();
-		obj_stringPrint();
+// A queued save has been written
+void cCreep::gameSaveComplete( string pFilename, bool pResult ) {
 
-		hw_Update();
-		hw_IntSleep(0x23);
-	} else
-		DisableSpritesAndStopSound();
+	if( pResult == true )
+		return;
+
+	cout << "IO ERROR: unable to save " << pFilename << endl;
+
+	// This can land on any frame, so leave the screen alone until the next transition
+	mSaveFailed = true;
+}
+
+// Put a failed save's IO ERROR up on its own screen, before the next one is drawn
+void cCreep::gameSaveErrorShow() {
 
+	if( mSaveFailed == false )
+		return;
+
+	mSaveFailed = false;
+
+	word objectPtr = mObjectPtr;
+
+	screenClear();
+	mObjectPtr = 0x25AA;	// IO ERROR
+	obj_stringPrint();
+
+	hw_Update();
+	hw_IntSleep( 0x23 );
+
+	mObjectPtr = objectPtr;
 }
 
 void cCreep::positionCalculate( byte pSpriteNumber ) {
@@ -5495,6 +5983,7 @@ void cCreep::obj_RayGun_Prepare() {
 				A -= 8;
 			}
 			mRoomAnim[X].mX = A;
+			mBroadphase->invalidate();
 		} 
 		
 		// 4D1A
@@ -5739,7 +6228,7 @@ void cCreep::obj_Door_Button_Prepare() {
 		byte A = 0;
 
 		// Find the colour of the door this button connects to
-		for( unsigned char Y = 0; Y < MAX_OBJECTS; ++Y ) {
+		for( unsigned char Y = 0; Y < mObjectsMax; ++Y ) {
 			if( mRoomAnim[Y].mObjectType != OBJECT_TYPE_DOOR ) 
 				continue;
 
@@ -5800,7 +6289,7 @@ void cCreep::obj_Lightning_Switch_InFront( byte pSpriteNumber, byte pObjectNumbe
 		mMemory[ word_32 ] ^= LIGHTNING_IS_ON;
 		byte Y;
 
-		for( Y = 0; Y < MAX_OBJECTS; ++Y ) {
+		for( Y = 0; Y < mObjectsMax; ++Y ) {
 			
 			if( mRoomAnim[Y].mObjectType != OBJECT_TYPE_LIGHTNING_MACHINE )
 				continue;
@@ -6681,7 +7170,7 @@ void cCreep::obj_RayGun_Laser_Execute( byte pSpriteNumber ) {
 // 3F14: Find a free object position, and clear it
 int cCreep::Sprite_CreepFindFree( ) {
 
-	for( int number = 0 ; number < MAX_SPRITES; ++number ) {
+	for( int number = 0 ; number < mSpritesMax; ++number ) {
 		sCreepSprite *sprite = &mRoomSprites[number];
 
 		if( sprite->state & SPR_UNUSED ) {
@@ -6728,6 +7217,12 @@ void cCreep::Draw_RoomAnimObject( byte pGfxID, byte pGfxPosX, byte pGfxPosY, byt
 	//57AE
 	mRoomAnim[pObjectNumber].mFlags = ((ITM_DISABLE ^ 0xFF) & mRoomAnim[pObjectNumber].mFlags);
 	mRoomAnim[pObjectNumber].mGfxID = pGfxID;
+
+	// Only a change in the object area requires the broadphase to rebuild
+	if( mRoomAnim[pObjectNumber].mX != pGfxPosX || mRoomAnim[pObjectNumber].mY != pGfxPosY ||
+		mRoomAnim[pObjectNumber].mWidth != (byte) (mGfxWidth << 2) || mRoomAnim[pObjectNumber].mHeight != mGfxHeight )
+		mBroadphase->invalidate();
+
 	mRoomAnim[pObjectNumber].mX = pGfxPosX;
 	mRoomAnim[pObjectNumber].mY = pGfxPosY;
 	mRoomAnim[pObjectNumber].mWidth = mGfxWidth;
@@ -6842,7 +7337,7 @@ void cCreep::obj_Door_Lock_InFront( byte pSpriteNumber, byte pObjectNumber ) {
 		return;
 
 	// This loop expects to find the object, if it doesnt, its meant to loop forever
-	for( byte X = 0; X < MAX_OBJECTS; ++X ) {
+	for( byte X = 0; X < mObjectsMax; ++X ) {
 
 		if( mRoomAnim[X].mObjectType != OBJECT_TYPE_DOOR )
 			continue;
@@ -7162,10 +7657,11 @@ void cCreep::obj_Conveyor_Control_InFront( byte pSpriteNumber, byte pObjectNumbe
 
 bool cCreep::object_Create( byte &pX ) {
 
-	if( mObjectCount == MAX_OBJECTS )
+	if( mObjectCount == mObjectsMax )
 		return false;
 
 	pX = mObjectCount++;
+	mBroadphase->invalidate();
 
 	mRoomAnim[pX].clear();
 	mRoomObjects[pX].clear();
@@ -30,6 +30,7 @@ class cPlayerInput;
 class cSound;
 class cDebug;
 class cBuilder;
+class cBroadphase;
 
 struct sObjectData {
 	byte mFlashData;
@@ -220,15 +221,49 @@ struct sCreepAnim {		// 0xBF
 	}
 };
 
+// The rooms drawn on the map screen, kept so only newly visited rooms need drawing
+struct sMapCache {
+	bool			mValid;
+	vector< byte >	mLayout;			// Room directory and door lists the map was drawn from
+	vector< byte >	mVisible;			// Rooms drawn, by directory entry
+	byte			mBitmap[ 0x1F40 ];	// 0xE000
+	byte			mScreen[ 0x3E8 ];	// 0xCC00
+	byte			mColor[ 0x3E8 ];	// 0xD800
+
+	sMapCache() {
+		mValid = false;
+	}
+};
+
 #define MAX_SPRITES 0x8
 #define MAX_OBJECTS 0x20
 
+// Large-room mode pools (object numbers are still stored as a byte)
+#define MAX_SPRITES_EXTENDED 0x40
+#define MAX_OBJECTS_EXTENDED 0xFF
+
+// Interrupt (logic tick) rates, and the most ticks which will be caught up after a stall
+#define TICK_RATE_PAL		50
+#define TICK_RATE_NTSC		60
+#define TICK_CATCHUP_MAX	4
+
+// Seconds between statistics reports
+#define STATS_REPORT_SECONDS	5
+
 class cCreep : public cSingleton<cCreep> {
 
 protected:
-	sCreepSprite	 mRoomSprites[ MAX_SPRITES ];	// BD00
-	sCreepObject	 mRoomObjects[ MAX_OBJECTS ];	// BE00
-	sCreepAnim		 mRoomAnim[ MAX_OBJECTS ];		// BF00
+	sCreepSprite	 mRoomSprites[ MAX_SPRITES_EXTENDED ];	// BD00
+	sCreepObject	 mRoomObjects[ MAX_OBJECTS_EXTENDED ];	// BE00
+	sCreepAnim		 mRoomAnim[ MAX_OBJECTS_EXTENDED ];		// BF00
+
+	byte			 mSpriteImages[ MAX_SPRITES_EXTENDED - MAX_SPRITES ][ 2 ][ 0x40 ];	// Sprite data for slots past the VIC-II eight
+	byte			 mSpriteImagesFrame[ MAX_SPRITES_EXTENDED - MAX_SPRITES ];
+
+	byte			 mSpritesMax, mObjectsMax;		// Current pool sizes
+	bool			 mLargeRooms;					// Large-room mode enabled
+	vector< byte >	 mSpriteCollisions;				// Sprites with a sprite collision this frame
+	vector< byte >	 mObjectCandidates;
 
 	byte			*mMemory,			*mGameData,		*mLevel,		*m64CharRom;
 
@@ -243,6 +278,7 @@ protected:
 	cPlayerInput	*mInput;
 	cSound			*mSound;
 	cBuilder		*mBuilder;
+	cBroadphase		*mBroadphase;
 
 	string			 mMusicCurrent;
 	string			 mWindowTitle;
@@ -250,11 +286,13 @@ protected:
 	size_t			 mMusicBufferSize;
 
 	byte		 mFileListingNamePtr;
+	byte		 mMenuCastlesPtr;				// First castle entry in the options menu listing
 	
 	bool		 mIntro;
 	byte		 mMenuMusicScore, mMenuScreenCount, mMenuScreenTimer;
 	byte		 mUnlimitedLives;
-	dword		 mTicksPrevious;
+	Uint64		 mTickNext, mTickPeriod;	// Deadline of the next interrupt, and the interrupt length (performance counter)
+	byte		 mTickRate;
 	timeb		 mPlayer1Time, mPlayer2Time;
 	int			 mPlayer1Seconds, mPlayer2Seconds;
 
@@ -301,13 +339,31 @@ protected:
 	byte		 mTxtPosLowerY, mTxtDestXLeft, mTxtDestX, mTxtEdgeScreenX;
 	byte		 mTxtDestXRight, mTxtWidth, mTxtHeight;
 	byte		 mGfxWidth, mGfxHeight;
+	sMapCache	 mMapCache;
 	byte		 mCount;
 	 
 	word		 word_30, word_32, word_3C, mObjectPtr, word_40, mRoomPtr;
 
 	bool		 mMenuReturn, mNoInput;
+	bool		 mSaveFailed;								// A queued save failed, IO ERROR waits for the next screen
 	uint8		 mTimer;
 
+	bool		 mLatencyMode;									// Report input to present latency
+	dword		 mLatencyInput;									// Timestamp of the oldest input not yet presented
+	dword		 mLatencyTotal, mLatencyCount, mLatencyMax;
+
+	void		 latencyPresented();
+
+	bool		 mStatsMode;									// Report frame and audio statistics
+	dword		 mStatsTicks;									// Time of the last report
+	dword		 mTickStalls;									// Times interruptWait dropped its backlog
+	void		 statsReport();
+
+	int			 mSoundQuality;									// eSoundQuality chosen by the user, or -1 for adaptive
+	dword		 mSoundRate, mSoundFrames;						// Requested output rate and device buffer size
+	void		 soundQualityApply();
+	void		 soundEffectBankBuild();
+
 public:
 	std::vector<cEvent>		mEvents;
 
@@ -343,12 +399,19 @@ public:
 
 		inline byte	mStrLengthGet() { return mStrLength; }
 
+		void	 largeRoomsSet( bool pEnabled );				// Enable the extended sprite/object pools
+		inline bool largeRoomsGet() { return mLargeRooms; }
+
+		void	 tickRateSet( byte pRate );						// Interrupts per second
+		inline byte tickRateGet() { return mTickRate; }
+
 		void	 builderStart( int pStartCastle );
 
 		cCastle	*castleGet() { return mCastle; }
 
 		void	 start( int pStartLevel, bool pUnlimited );			// Game Entry Point
 		void	 run( int pArgCount, char *pArgs[] );					// Executed from main()
+		bool	 soundRender( string pSource, string pFile );		// Write music/effect to a WAV
 
 		void	 roomPtrSet( byte pRoomNumber );
 
@@ -362,9 +425,12 @@ public:
 		void	 gameEscapeCastle();
 		void	 gameHighScores( );
 		void	 optionsMenuPrepare();
+		void	 optionsMenuCastlesPrepare();		// Write the castle names into the options menu
 
 		void	 gamePositionLoad();
 		void	 gamePositionSave( bool pCastleSave );
+		void	 gameSaveComplete( string pFilename, bool pResult );	// A queued save has been written
+		void	 gameSaveErrorShow();					// Show a failed save between screens
 		void	 gameFilenameGet( bool pLoading, bool pCastleSave );
 
 		void	 stringSet( byte pPosX, byte pPosY, byte pColor, string pMessage );
@@ -374,6 +440,8 @@ public:
 		void	 hw_Update();							// 
 		void	 hw_IntSleep( byte pA );				// hardware interrupt wait loop
 		void	 hw_SpritePrepare( byte pSpriteNumber );// prepare a sprite 
+		byte	*hw_SpriteBufferGet( byte pSpriteNumber );	// Back buffer for a sprites data
+		byte	*hw_SpriteBufferFlip( byte pSpriteNumber );	// Swap a sprites data buffer, returning the new one
 
 		bool	 Intro();								// Intro Loop
 		void	 interruptWait( byte pCount );			// Wait 'pCount' amount of VIC-II interrupt executions
@@ -383,6 +451,8 @@ public:
 		void	 mapArrowDraw( byte pPlayer );
 		bool	 mapDisplay();							// Map Screen
 		void	 mapRoomDraw();							// Draw the rooms on the map
+		void	 mapRoomDrawSingle();					// Draw the room at mRoomPtr
+		void	 mapRoomsUpdate();						// Draw the rooms on the map, from the cache where possible
 		
 		void	 menuUpdate( size_t pCastleNumber );
 		void     musicChange();
@@ -409,6 +479,7 @@ public:
 
 		void	 gameHighScoresHandle();
 		void	 sound_PlayEffect( char pA );
+		void	 sound_EffectSequence( char pA );
 		
 		void	 textPrintCharacter();
 		byte	 textGetKeyFromUser();
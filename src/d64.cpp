@@ -28,6 +28,43 @@
 #include "stdafx.h"
 #include "d64.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// First sector of each track, counted from the start of the image
+const word cD64::mTrackOffsets[36] = {
+	  0,
+	  0,  21,  42,  63,  84, 105, 126, 147, 168, 189, 210, 231, 252, 273, 294, 315, 336,	// 21 sectors
+	357, 376, 395, 414, 433, 452, 471,														// 19 sectors
+	490, 508, 526, 544, 562, 580,															// 18 sectors
+	598, 615, 632, 649, 666																	// 17 sectors
+};
+
+// Index of the lowest set bit, 'pValue' must not be zero
+static inline byte bitFirst( dword pValue ) {
+#ifdef _MSC_VER
+	unsigned long index;
+
+	_BitScanForward( &index, pValue );
+	return (byte) index;
+#else
+	return (byte) __builtin_ctz( pValue );
+#endif
+}
+
+// FNV-1a, guards the journal against a torn write
+static dword journalHash( const byte *pBuffer, size_t pSize ) {
+	dword hash = 0x811C9DC5;
+
+	for( size_t i = 0; i < pSize; ++i ) {
+		hash ^= pBuffer[i];
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
 // Function to rip a string from a byte array
 string stringRip(byte *pBuffer, byte pTerminator, size_t pLengthMax) {
 	string tmpString;
@@ -39,10 +76,13 @@ string stringRip(byte *pBuffer, byte pTerminator, size_t pLengthMax) {
 }
 
 // D64 Constructor
-cD64::cD64( string pD64, string pPath, bool pCreate, bool pDataSave, bool pReadOnly ) {
+cD64::cD64( string pD64, string pPath, bool pCreate, bool pDataSave, bool pReadOnly, bool pMap ) {
 
 	// Prepare variables
+	mBuffer = 0;
 	mBufferSize = 0;
+	mMapped = false;
+	mWriteAll = false;
 	mCreated = false;
 	mReady = false;
 	mLastOperationFailed = false;
@@ -58,14 +98,31 @@ cD64::cD64( string pD64, string pPath, bool pCreate, bool pDataSave, bool pReadO
 	mTrackCount = 35;
 
 	bamClear();
+	memset( mSectorDirty, 0, sizeof( mSectorDirty ) );
+
+	// Finish any write which was cut short, before looking at the image
+	if( !mRead )
+		journalReplay();
+
+	// Map the image, only the pages we touch get read. A mapped file which is replaced while
+	// open faults on the next access, so only images nothing else will swap are mapped
+	if( pMap ) {
+		mBuffer = local_FileMap( pD64, mPath, mBufferSize, pDataSave );
+		if( mBuffer )
+			mMapped = true;
+	}
 
-	// Read the file
-	mBuffer = local_FileRead( pD64, mPath, mBufferSize, pDataSave );
+	if( !mBuffer )
+		mBuffer = local_FileRead( pD64, mPath, mBufferSize, pDataSave );
 
 	// Loaded size is 0 and we're not in create mode?
 	if( !mBuffer && !pCreate )
 		return;
 
+	// Too small to hold a whole disk
+	if( mBufferSize && mBufferSize < sectorsTotal() * 256 )
+		return;
+
 	// Creating a file?
 	if( !mBufferSize ) {
 		mRead = false;
@@ -83,6 +140,7 @@ cD64::cD64( string pD64, string pPath, bool pCreate, bool pDataSave, bool pReadO
 		bamCreate();
 
 		// Write out the new disk
+		mWriteAll = true;
 		diskWrite();
 
 		mCreated = true;
@@ -108,8 +166,11 @@ cD64::~cD64( ) {
 	// Cleanup loaded files memory
 	filesCleanup();
 
-	// Delete the disk buffer
-	delete mBuffer;
+	// Release the disk buffer
+	if( mMapped )
+		local_FileUnmap( mBuffer, mBufferSize );
+	else
+		delete mBuffer;
 }
 
 // Check the BAM against the loaded information
@@ -117,18 +178,11 @@ bool cD64::bamTest( ) {
 
 	for( byte track = 1; track <= mTrackCount; ++track )
 
-		// Check each sector of the track
+		// Check each sector of the track, it must be either free or used by a file
 		for( byte sector = 0; sector < trackRange( track ); ++sector ) {
 		
-			if( mBamTracks[track][sector] )
-				if( !mBamRealTracks[track][sector] )
-					continue;
-
-			if( !mBamTracks[track][sector] )
-				if( mBamRealTracks[track][sector] )
-					continue;
-
-			return false;
+			if( (bool) ((mBamTracks[track] >> sector) & 1) == (mBamRealTracks[track][sector] != 0) )
+				return false;
 		}
 
 	return true;
@@ -174,22 +228,17 @@ void cD64::bamCreate() {
 
 // Set BAM to empty disk state
 void cD64::bamClear() {
-	byte range = 0;
+
+	memset( mBamRealTracks, 0, sizeof( mBamRealTracks ) );
+	mBamFreeTotal = 0;
 
 	// Clear BAM memory 
 	for( byte T = 0; T <= mTrackCount; ++T ) {
-		mBamFree[T] = range = trackRange(T);
-
-		for( byte S = 0; S <= 0x17; ++S ) {
-			mBamRealTracks[T][S] = 0;
+		mBamFree[T] = trackRange(T);
+		mBamTracks[T] = trackMask(T);
 
-			if(S < range) {
-				
-				mBamTracks[T][S] = true;
-			} else {
-				mBamTracks[T][S] = false; 
-			}
-		}
+		if( T )
+			mBamFreeTotal += mBamFree[T];
 	}
 }
 
@@ -199,28 +248,20 @@ void cD64::bamLoadFromBuffer() {
 
 	bamClear();
 
+	if( !buffer )
+		return;
+
 	// Load the BAM
 	buffer += 0x04;
+	mBamFreeTotal = 0;
 
-	for( size_t T = 1; T <= mTrackCount; ++T ) {
+	for( size_t T = 1; T <= mTrackCount; ++T, buffer += 4 ) {
 		// Free Sector Count
-		mBamFree[T] = *buffer++;
-			
-		// Load each sector
-		for( size_t S = 0; S <= 0x17; ) {
+		mBamFree[T] = buffer[0];
+		mBamFreeTotal += mBamFree[T];
 
-			byte data = *buffer++;
-
-			// Load the value for each sector in this byte
-			for( byte count = 0; count < 8; ++count, ++S ) {
-				if( data & 0x01 )
-					mBamTracks[T][S] = true;
-				else
-					mBamTracks[T][S] = false;
-
-				data >>= 1;
-			}
-		}
+		// Three bytes of sector flags, sector 0 in the lowest bit
+		mBamTracks[T] = (buffer[1] | (buffer[2] << 8) | (buffer[3] << 16)) & trackMask( T );
 	}
 
 }
@@ -229,86 +270,56 @@ void cD64::bamLoadFromBuffer() {
 void cD64::bamSaveToBuffer() {
 	byte *buffer = sectorPtr( 18, 0 );
 
+	if( !buffer )
+		return;
+
 	buffer += 4;
 
 	// Loop each track
-	for( size_t track = 1; track <= mTrackCount; ++track ) {
-		size_t sectors = trackRange( track );
+	for( size_t track = 1; track <= mTrackCount; ++track, buffer += 4 ) {
 
-		// Set number of free sectors
+		// Set number of free sectors, then the three bytes of sector flags
 		buffer[0] = mBamFree[track];
-		++buffer;
-
-		// Loop each sector on this track
-		for( size_t sector = 0; sector < sectors; ) {
-			byte final = 0;
-
-			// Loop each sector 
-			for( size_t count = 0; count < 8; ++count, ++sector ) {
-				final >>= 1;
-
-				// Mark it free if its free
-				if( mBamTracks[track][sector] == true )
-					final |= 0x80;
-			}
-
-			// Save this byte of sector BAM
-			*buffer++ = final;	
-		}
+		buffer[1] = (byte) mBamTracks[track];
+		buffer[2] = (byte) (mBamTracks[track] >> 8);
+		buffer[3] = (byte) (mBamTracks[track] >> 16);
 	}
 }
 
 // Mark a sector as being Used/Free in the internal 'mBamTracks'
 void cD64::bamSectorMark( size_t pTrack, size_t pSector, bool pValue ) {
-	
-	// Check if the sector was marked in use already
-	if( mBamTracks[pTrack][pSector] == true ) {
+	dword bit = 1 << pSector;
+	bool  free = (mBamTracks[pTrack] & bit) != 0;
 
-		// Marked Free
-		if( pValue == false )
-			--mBamFree[pTrack];
-
-	} else {
-		// Marked in use
-		if( pValue == true )
+	// Only count a change of state
+	if( free != pValue ) {
+		if( pValue ) {
 			++mBamFree[pTrack];
+			++mBamFreeTotal;
+		} else {
+			--mBamFree[pTrack];
+			--mBamFreeTotal;
+		}
 	}
 
-	mBamTracks[pTrack][pSector] = pValue;
+	if( pValue )
+		mBamTracks[pTrack] |= bit;
+	else
+		mBamTracks[pTrack] &= ~bit;
 }
 
 // Check a track for free sectors
 bool cD64::bamTrackSectorFree( byte &pTrack, byte &pSector ) {
-	byte track = pTrack;
-	bool wrapped = false;
+	dword free = mBamTracks[pTrack];
 
-	// Loop each sector in this track
-	for( byte sector = pSector; sector < trackRange( track ); ) {
-			
-		// Is this sector free
-		if( mBamTracks[track][sector] == true ) {
-			pTrack = track;
-			pSector = sector;
-			return true;
-		}
-	
-		++sector;
-
-		// Check its in range for the track
-		if( sector >= trackRange( track ) ) {
-			if( wrapped == false ) {
-				wrapped = true;
-				sector = 0;
-				pSector = 0;
-				continue;
-			}
-			
-			return false;
-		}	// If >= trackrange
+	if( !free )
+		return false;
 
-	}	// For Sector
+	// First free sector from 'pSector' on, wrapping back to the start of the track
+	dword ahead = (pSector < 24) ? (free & (0xFFFFFFFF << pSector)) : 0;
 
-	return false;
+	pSector = bitFirst( ahead ? ahead : free );
+	return true;
 }
 
 // Find a free sector
@@ -421,6 +432,12 @@ bool cD64::bamSectorFree( byte &pTrack, byte &pSector, byte pDirectoryTrack ) {
 // Check a disk for errors
 bool cD64::diskTest() {
 	vector< sD64Chain >::iterator			 linkIT;
+	vector< sD64File* >::iterator			 fileIT;
+
+	// The real track usage is only known once every chain has been walked
+	for( fileIT = mFiles.begin(); fileIT != mFiles.end(); ++fileIT )
+		(*fileIT)->bufferGet();
+
 	if(!bamTest()) {
 
 		// Bam Disk test failed
@@ -438,6 +455,49 @@ bool cD64::diskTest() {
 	return true;
 }
 
+// Find damaged files and BAM errors, returns true if there were none
+bool cD64::diskCheck( vector< sD64Problem > &pProblems ) {
+	vector< sD64Chain >::iterator			 linkIT;
+	vector< sD64File* >::iterator			 fileIT;
+	size_t									 count = pProblems.size();
+
+	// Walk every chain, so the real usage of each sector is known
+	for( fileIT = mFiles.begin(); fileIT != mFiles.end(); ++fileIT ) {
+		sD64File *file = *fileIT;
+
+		// Scratched files no longer own their sectors
+		if( file->mFileType == eD64FileType_DEL )
+			continue;
+
+		file->bufferGet();
+
+		if( file->mChainBroken )
+			pProblems.push_back( sD64Problem( eD64Problem_ChainBroken, file->mName, file->mTrack, file->mSector ) );
+	}
+
+	for( linkIT = mCrossLinked.begin(); linkIT != mCrossLinked.end(); ++linkIT ) {
+		sD64File *owner = mBamRealTracks[ linkIT->mTrack ][ linkIT->mSector ];
+
+		pProblems.push_back( sD64Problem( eD64Problem_CrossLinked, linkIT->mFile->mName, (byte) linkIT->mTrack, (byte) linkIT->mSector, owner ? owner->mName : "" ) );
+	}
+
+	// Compare the BAM against the sectors the files really use
+	for( byte track = 1; track <= mTrackCount; ++track ) {
+		for( byte sector = 0; sector < trackRange( track ); ++sector ) {
+			sD64File *owner = mBamRealTracks[track][sector];
+			bool	  free = (mBamTracks[track] >> sector) & 1;
+
+			if( free && owner )
+				pProblems.push_back( sD64Problem( eD64Problem_SectorFree, owner->mName, track, sector ) );
+
+			if( !free && !owner )
+				pProblems.push_back( sD64Problem( eD64Problem_SectorLost, "", track, sector ) );
+		}
+	}
+
+	return pProblems.size() == count;
+}
+
 // Load an entry
 sD64File *cD64::directoryEntryLoad( byte *pBuffer ) {
 	sD64File *file = new sD64File();
@@ -459,10 +519,11 @@ sD64File *cD64::directoryEntryLoad( byte *pBuffer ) {
 	// Total number of blocks
 	file->mFileSize = readLEWord( &pBuffer[0x1E] );
 
-	// Load the file into a new buffer
-	if(file->mFileSize > 0)
-		fileLoad( file );
-		
+	// The chain is walked when the file is first used
+	file->mDisk = this;
+	if(file->mFileSize == 0)
+		file->mLoaded = true;
+
 	return file;
 }
 
@@ -475,6 +536,10 @@ void cD64::directoryLoad() {
 	// Cleanup previous load
 	filesCleanup();
 
+	// The BAM sector belongs to the directory
+	mDirectory.mName = "$";
+	mBamRealTracks[18][0] = &mDirectory;
+
 	// Loop until the current Track/Sector is invalid
 	while( (currentTrack > 0 && currentTrack <= mTrackCount) && (currentSector <= trackRange( currentTrack )) ) {
 		sectorBuffer = sectorPtr( currentTrack, currentSector );
@@ -483,6 +548,12 @@ void cD64::directoryLoad() {
 		if(!buffer)
 			break;
 
+		// Stop if the chain loops back on itself
+		if( mBamRealTracks[currentTrack][currentSector] == &mDirectory )
+			break;
+
+		mBamRealTracks[currentTrack][currentSector] = &mDirectory;
+
 		// 8 Entries per sector, 0x20 bytes per entry
 		for( byte i = 0; i <= 7; ++i, buffer += 0x20 ) {
 			
@@ -538,6 +609,7 @@ bool cD64::directoryAdd( sD64File *pFile ) {
 	while( (currentTrack > 0 && currentTrack <= mTrackCount) && (currentSector <= trackRange( currentTrack )) ) {
 		sectorBuffer = sectorPtr( currentTrack, currentSector );
 		byte *buffer = sectorBuffer;
+		byte  sectorTrack = currentTrack, sectorSector = currentSector;
 		
 		if(!buffer)
 			break;
@@ -557,9 +629,11 @@ bool cD64::directoryAdd( sD64File *pFile ) {
 			// Found one, lets set it
 			sectorBuffer[0] = currentTrack;
 			sectorBuffer[1] = currentSector;
+			sectorDirty( sectorTrack, sectorSector );
 
 			// Mark it in use
 			bamSectorMark( currentTrack, currentSector, false );
+			mBamRealTracks[currentTrack][currentSector] = &mDirectory;
 		}
 
 		// Loop for 8 Entries, at 0x20 bytes per entry
@@ -571,6 +645,7 @@ bool cD64::directoryAdd( sD64File *pFile ) {
 
 				 // Found free entry entry, overwrite it with the new file details
 				directoryEntrySet( i, pFile, buffer );
+				sectorDirty( sectorTrack, sectorSector );
 
 				return true;
 			 }
@@ -599,13 +674,44 @@ void cD64::filesCleanup() {
 
 // Load a file from the disk
 bool cD64::fileLoad( sD64File *pFile ) {
-	word bytesCopied = 0, copySize = 0xFE;
+	size_t bytesCopied = 0;
+	word copySize = 0xFE;
 	byte currentTrack = pFile->mTrack, currentSector = pFile->mSector;
 	bool   noCopy = false;
 
 	// Cleanup old buffer
-	delete pFile->mBuffer;
-	
+	if( !pFile->mView )
+		delete pFile->mBuffer;
+
+	pFile->mBuffer = 0;
+	pFile->mView = false;
+
+	// Clear any previous chain information
+	pFile->mTSChain.clear();
+
+	// Forget cross links found by an earlier walk of this chain
+	for( size_t link = mCrossLinked.size(); link > 0; --link ) {
+		if( mCrossLinked[ link - 1 ].mFile == pFile )
+			mCrossLinked.erase( mCrossLinked.begin() + (link - 1) );
+	}
+
+	// A file held in a single sector is used in place, without a copy
+	byte *first = sectorPtr( currentTrack, currentSector );
+	if( first && first[0] == 0 && first[1] >= 2 ) {
+
+		if(mBamRealTracks[currentTrack][currentSector] && mBamRealTracks[currentTrack][currentSector] != pFile)
+			mCrossLinked.push_back( sD64Chain( currentTrack, currentSector, pFile ) );
+		else
+			mBamRealTracks[currentTrack][currentSector] = pFile;
+
+		pFile->mTSChain.push_back( sD64Chain( currentTrack, currentSector, pFile ) );
+
+		pFile->mBuffer = first + 2;
+		pFile->mBufferSize = first[1] - 1;
+		pFile->mView = true;
+		return true;
+	}
+
 	// Prepare the buffer, (Each block is 254 bytes, the remaining two is used for the T/S chain)
 	pFile->mBufferSize = (pFile->mFileSize * copySize);
 	pFile->mBuffer = new byte[ pFile->mBufferSize ];
@@ -613,15 +719,19 @@ bool cD64::fileLoad( sD64File *pFile ) {
 	// Temp buffer ptr
 	byte *destBuffer = pFile->mBuffer;
 
-	// Clear any previous chain information
-	pFile->mTSChain.clear();
-
 	// Loop until invalid track
 	while( currentTrack  ) {
 		
 		// Get ptr to current sector
 		byte *buffer = sectorPtr( currentTrack, currentSector );
 
+		// A chain longer than the disk must loop, and a last sector must hold at least its own link
+		if( pFile->mTSChain.size() >= sectorsTotal() || (buffer && buffer[0] == 0 && buffer[1] == 0) ) {
+			pFile->mChainBroken = true;
+
+			return false;
+		}
+
 		if(!buffer) {
 
 			// Reached an invalid track/sector! Abort if not noCopy mode,
@@ -635,8 +745,8 @@ bool cD64::fileLoad( sD64File *pFile ) {
 			return false;
 		}
 	
-		// Track/Sector already in use?
-		if(mBamRealTracks[currentTrack][currentSector]) {
+		// Track/Sector already in use? (a retry walks its own sectors again)
+		if(mBamRealTracks[currentTrack][currentSector] && mBamRealTracks[currentTrack][currentSector] != pFile) {
 
 			// Add to the crosslinked list
 			mCrossLinked.push_back( sD64Chain( currentTrack, currentSector, pFile ) );
@@ -683,14 +793,16 @@ bool cD64::fileLoad( sD64File *pFile ) {
 	return true;
 }
 
-// Save a file as a PRG to the disk
-bool cD64::fileSave( string pFilename, byte *pData, size_t pBytes, word pLoadAddress ) {
+// Save a file as a PRG to the disk, returns the new directory entry
+sD64File *cD64::fileSave( string pFilename, byte *pData, size_t pBytes, word pLoadAddress, sD64File *pReplace ) {
 	size_t		bytesRemain = pBytes + 2;		// Add the Load Address Bytes
 	sD64File	File;
 	
 	// Upper case only for C64 filenames
 	transform( pFilename.begin(), pFilename.end(), pFilename.begin(), ::toupper );
 	
+	bufferPrivate();
+
 	// Set the file details
 	File.mName = pFilename;
 	File.mFileType = (eD64FileType) 0x82;		// PRG
@@ -700,6 +812,7 @@ bool cD64::fileSave( string pFilename, byte *pData, size_t pBytes, word pLoadAdd
 	byte	*buffer = 0, *bufferSrc = pData;
 	byte	 track = 0, sector = 0;
 	size_t	 copySize = 0;
+	vector< sD64Chain > chain;
 
 	bool sectorFirst = true;
 
@@ -707,8 +820,10 @@ bool cD64::fileSave( string pFilename, byte *pData, size_t pBytes, word pLoadAdd
 	while( bytesRemain ) {
 		
 		// Get available T/S
-		if( bamSectorFree( track, sector ) == false )
-			return false;
+		if( bamSectorFree( track, sector ) == false ) {
+			chainFree( chain );
+			return 0;
+		}
 		
 		// Set the next T/S in the previous sector
 		if(buffer) {
@@ -722,21 +837,23 @@ bool cD64::fileSave( string pFilename, byte *pData, size_t pBytes, word pLoadAdd
 
 		// Grab buffer to next sector
 		buffer = sectorPtr( track, sector );
+		sectorDirty( track, sector );
 		
 		// If its the first sector, we have to write the load address
 		if( sectorFirst ) {
 			writeLEWord( &buffer[0x02], pLoadAddress );
 
-			// Copy filedata
-			if(bytesRemain < 0xFC )
+			// Copy filedata, the load address uses the first two bytes
+			if(bytesRemain < 0xFE )
 				copySize = bytesRemain;
 			else		
-				copySize = 0xFC;
+				copySize = 0xFE;
 
 			sectorFirst = false;
 
 			// Copy the source to the disk buffer
-			memcpy( buffer + 4, bufferSrc, copySize );
+			memcpy( buffer + 4, bufferSrc, copySize - 2 );
+			bufferSrc += copySize - 2;
 
 		} else {
 			// Normal sector write
@@ -749,65 +866,110 @@ bool cD64::fileSave( string pFilename, byte *pData, size_t pBytes, word pLoadAdd
 
 			// Copy the source to the disk buffer
 			memcpy( buffer + 2, bufferSrc, copySize );
+			bufferSrc += copySize;
 		}
-		
-		// Move the source forward
-		bufferSrc += copySize;
 
 		// Mark the sector in use
 		bamSectorMark( track, sector, false );
+		chain.push_back( sD64Chain( track, sector, 0 ) );
 		
 		if(bytesRemain > 0)
 			bytesRemain -= copySize;
 	};
 	
-	// Set the Track to none (to mark end of chain), and the sector the the number of bytes used
+	// Set the Track to none (to mark end of chain), and the sector to the offset of the last byte used
 	buffer[0] = 0;
-	buffer[1] = (uint8) (copySize - 1);
+	buffer[1] = (uint8) (copySize + 1);
 
 	// Add entry to the directory
-	if( directoryAdd( &File ) == false )
-		return false;
+	if( directoryAdd( &File ) == false ) {
+		chainFree( chain );
+		return 0;
+	}
+
+	// Keep the loaded file list in step with the directory, in the same form fileLoad produces
+	sD64File *file = new sD64File();
+
+	file->mName = File.mName;
+	file->mDisk = this;
+	file->mLoaded = true;
+	file->mFileType = eD64FileType_PRG;
+	file->mTrack = File.mTrack;
+	file->mSector = File.mSector;
+	file->mFileSize = (word) ((pBytes + 2 + 253) / 254);
+	file->mBufferSize = pBytes + 2;
+	file->mBuffer = new byte[ file->mBufferSize ];
+
+	writeLEWord( file->mBuffer, pLoadAddress );
+	memcpy( file->mBuffer + 2, pData, pBytes );
+
+	// Record the chain, so the file can be deleted again
+	for( vector< sD64Chain >::iterator chainIT = chain.begin(); chainIT != chain.end(); ++chainIT ) {
+		chainIT->mFile = file;
+		mBamRealTracks[ chainIT->mTrack ][ chainIT->mSector ] = file;
+	}
+	file->mTSChain.swap( chain );
+
+	mFiles.push_back( file );
+
+	// The copy being replaced kept its sectors while this one was allocated, it is scratched in the same write
+	bool replaced = false;
+	if( pReplace && pReplace->mDisk == this )
+		replaced = fileScratch( pReplace, true );
+
+	if( diskWrite() == false ) {
 
-	return diskWrite();
+		// Put the disk back as it was, so the next write can not persist half of this save
+		fileScratch( file, true );
+		fileRelease( file );
+
+		if( replaced )
+			fileScratch( pReplace, false );
+
+		return 0;
+	}
+
+	if( replaced )
+		fileRelease( pReplace );
+
+	return file;
 }
 
 // Obtain pointer to 'pTrack'/'pSector' in the disk buffer
 byte *cD64::sectorPtr( dword pTrack, dword pSector ) {
-	dword	currentTrack, currentRange;
-	dword	offset = 0;
 
-	// Invalid track?
-	if(pTrack <= 0 || pTrack > mTrackCount)
+	// Invalid track or sector?
+	if( pTrack == 0 || pTrack > mTrackCount || pSector >= trackRange( pTrack ) )
 		return 0;
 
-	// Invalid sector?
-	if(pSector < 0 || pSector > trackRange(pTrack))
+	size_t offset = (mTrackOffsets[ pTrack ] + pSector) * 256;
+
+	if( offset + 256 > mBufferSize )
 		return 0;
 
-	// Loop through each track, and add up
-	for(currentTrack = 1; currentTrack <= pTrack; currentTrack++) {
-		currentRange = trackRange( currentTrack );
+	return (mBuffer + offset);
+}
 
-		// If we're not looking for this track
-		if(currentTrack != pTrack) {
+// Copy a mapped image into our own buffer before changing it
+void cD64::bufferPrivate() {
+	vector< sD64File* >::iterator fileIT;
 
-			//increase the offset to the end of the track
-			offset += (256 * currentRange);
-			continue;
-		} else {
-			//increase offset to the sector we're after
-			offset += (256 * pSector);
+	if( !mMapped )
+		return;
 
-			if( offset >= mBufferSize )
-				return 0;
+	byte *buffer = new byte[ mBufferSize ];
+	memcpy( buffer, mBuffer, mBufferSize );
 
-			// Return pointer
-			return (mBuffer + offset);
-		}
+	// Move any files used in place across to the new buffer
+	for( fileIT = mFiles.begin(); fileIT != mFiles.end(); ++fileIT ) {
+		if( (*fileIT)->mView )
+			(*fileIT)->mBuffer = buffer + ((*fileIT)->mBuffer - mBuffer);
 	}
 
-	return 0;
+	local_FileUnmap( mBuffer, mBufferSize );
+
+	mBuffer = buffer;
+	mMapped = false;
 }
 
 // Write the buffer to the D64
@@ -817,10 +979,137 @@ bool cD64::diskWrite() {
 	if( mRead || mLastOperationFailed)
 		return false;
 
-	// Store the internal 'mBuffer'
+	// Nothing has changed while the image is still mapped
+	if( mMapped )
+		return true;
+
+	// Store the internal 'mBamTracks', only writing track 18/0 if it changed
+	byte *bam = sectorPtr( 18, 0 ), bamPrevious[256];
+
+	if( bam )
+		memcpy( bamPrevious, bam, sizeof( bamPrevious ) );
+
 	bamSaveToBuffer();
 
-	return local_FileSave( mFilename, mPath, mDataSave, mBuffer, mBufferSize );
+	if( bam && memcmp( bamPrevious, bam, sizeof( bamPrevious ) ) )
+		sectorDirty( 18, 0 );
+
+	if( mWriteAll ) {
+		if( !local_FileSave( mFilename, mPath, mDataSave, mBuffer, mBufferSize ) )
+			return false;
+
+		mWriteAll = false;
+		memset( mSectorDirty, 0, sizeof( mSectorDirty ) );
+		return true;
+	}
+
+	return sectorsWrite();
+}
+
+// Write the changed sectors. They go to a journal first, which is replayed on the next open if we dont finish
+bool cD64::sectorsWrite() {
+	vector< byte >	journal;
+	dword			count = 0;
+
+	journal.resize( 8 );
+	memcpy( &journal[0], "CRPJ", 4 );
+
+	for( size_t track = 1; track <= mTrackCount; ++track ) {
+		for( size_t sector = 0; sector < trackRange( track ); ++sector ) {
+			byte *buffer = sectorPtr( track, sector );
+
+			if( !mSectorDirty[track][sector] || !buffer )
+				continue;
+
+			// Offset of the sector in the image, and its contents
+			size_t pos = journal.size();
+			journal.resize( pos + 4 + 256 );
+
+			writeLEWord( &journal[pos], (buffer - mBuffer) & 0xFFFF );
+			writeLEWord( &journal[pos + 2], (word) ((buffer - mBuffer) >> 16) );
+			memcpy( &journal[pos + 4], buffer, 256 );
+			++count;
+		}
+	}
+
+	if( !count )
+		return true;
+
+	writeLEWord( &journal[4], count & 0xFFFF );
+	writeLEWord( &journal[6], (word) (count >> 16) );
+
+	dword hash = journalHash( &journal[0], journal.size() );
+	journal.resize( journal.size() + 4 );
+	writeLEWord( &journal[ journal.size() - 4 ], hash & 0xFFFF );
+	writeLEWord( &journal[ journal.size() - 2 ], (word) (hash >> 16) );
+
+	// Get the journal onto the storage, before touching the image
+	FILE *file = local_FileOpen( mFilename + D64_JOURNAL_EXT, mPath, mDataSave, "wb" );
+	if( !file )
+		return false;
+
+	bool written = (fwrite( &journal[0], journal.size(), 1, file ) == 1) && local_FileSync( file );
+	fclose( file );
+
+	if( !written || !journalApply( &journal[0], journal.size() ) ) {
+		cout << "Disk: unable to write " << mFilename << endl;
+		return false;
+	}
+
+	local_FileRemove( mFilename + D64_JOURNAL_EXT, mPath, mDataSave );
+
+	memset( mSectorDirty, 0, sizeof( mSectorDirty ) );
+	return true;
+}
+
+// Write the sectors held in a journal to the image
+bool cD64::journalApply( const byte *pJournal, size_t pSize ) {
+
+	// Header, count, and the hash of both plus the sectors
+	if( pSize < 12 || memcmp( pJournal, "CRPJ", 4 ) )
+		return false;
+
+	dword count = readLEWord( pJournal + 4 ) | (readLEWord( pJournal + 6 ) << 16);
+	if( pSize != 12 + (count * (4 + 256)) )
+		return false;
+
+	dword hash = readLEWord( pJournal + pSize - 4 ) | (readLEWord( pJournal + pSize - 2 ) << 16);
+	if( hash != journalHash( pJournal, pSize - 4 ) )
+		return false;
+
+	FILE *file = local_FileOpen( mFilename, mPath, mDataSave, "r+b" );
+	if( !file )
+		return false;
+
+	const byte *sector = pJournal + 8;
+	bool		result = true;
+
+	for( dword i = 0; i < count && result; ++i, sector += 4 + 256 ) {
+		dword offset = readLEWord( sector ) | (readLEWord( sector + 2 ) << 16);
+
+		result = (fseek( file, offset, SEEK_SET ) == 0) && (fwrite( sector + 4, 256, 1, file ) == 1);
+	}
+
+	if( result )
+		result = local_FileSync( file );
+
+	fclose( file );
+	return result;
+}
+
+// Finish a write interrupted by a crash. A journal which fails its check was never completed, and the image is untouched
+void cD64::journalReplay() {
+	size_t	 size = 0;
+	byte	*journal = local_FileRead( mFilename + D64_JOURNAL_EXT, mPath, size, mDataSave );
+
+	if( !journal )
+		return;
+
+	if( journalApply( journal, size ) )
+		cout << "Disk: completed an interrupted write to " << mFilename << endl;
+
+	local_FileRemove( mFilename + D64_JOURNAL_EXT, mPath, mDataSave );
+	delete journal;
 }
 
 // Get a file
@@ -833,13 +1122,145 @@ sD64File *cD64::fileGet( string pFilename ) {
 	// Loop thro all files on disk for specific filename
 	for( fileIT = mFiles.begin(); fileIT != mFiles.end(); ++fileIT ) {
 
-		if( (*fileIT)->mName == pFilename )
+		if( (*fileIT)->mFileType != eD64FileType_DEL && (*fileIT)->mName == pFilename )
 			return *fileIT;
 	}
 
 	return 0;
 }
 
+// Get the file starting at 'pTrack'/'pSector'
+sD64File *cD64::fileGet( byte pTrack, byte pSector ) {
+	vector< sD64File* >::iterator fileIT;
+
+	for( fileIT = mFiles.begin(); fileIT != mFiles.end(); ++fileIT ) {
+
+		if( (*fileIT)->mFileType != eD64FileType_DEL && (*fileIT)->mTrack == pTrack && (*fileIT)->mSector == pSector )
+			return *fileIT;
+	}
+
+	return 0;
+}
+
+// Find the directory entry of 'pFile', live or scratched, and the sector holding it
+byte *cD64::directoryEntryFind( sD64File *pFile, bool pScratched, byte &pTrack, byte &pSector ) {
+	byte currentTrack = 0x12, currentSector = 1;
+
+	for( size_t sectors = 0; currentTrack && sectors < trackRange( 0x12 ); ++sectors ) {
+		byte *buffer = sectorPtr( currentTrack, currentSector );
+
+		if( !buffer )
+			break;
+
+		for( byte i = 0; i <= 7; ++i ) {
+			byte *entry = buffer + (i * 0x20);
+			bool  scratched = (entry[0x02] & 0x0F) == eD64FileType_DEL;
+
+			if( scratched == pScratched && entry[0x03] == pFile->mTrack && entry[0x04] == pFile->mSector &&
+				stringRip( entry + 0x05, 0xA0, 16 ) == pFile->mName ) {
+
+				pTrack = currentTrack;
+				pSector = currentSector;
+				return entry;
+			}
+		}
+
+		currentTrack = buffer[0];
+		currentSector = buffer[1];
+	}
+
+	return 0;
+}
+
+// Scratch a file, or bring a scratched one back as a PRG.
+// Only the sectors the file owns are freed, never one cross linked with another file
+bool cD64::fileScratch( sD64File *pFile, bool pScratch ) {
+	vector< sD64Chain >::iterator chainIT;
+	byte track = 0, sector = 0;
+
+	if( !pFile || pFile->mDisk != this || mRead )
+		return false;
+
+	if( (pFile->mFileType == eD64FileType_DEL) == pScratch )
+		return false;
+
+	// The chain must be known to free it
+	if( pScratch && !fileExtract( pFile ) )
+		return false;
+
+	bufferPrivate();
+
+	byte *entry = directoryEntryFind( pFile, !pScratch, track, sector );
+	if( !entry )
+		return false;
+
+	pFile->mFileType = pScratch ? eD64FileType_DEL : eD64FileType_PRG;
+	entry[0x02] = pScratch ? (byte) eD64FileType_DEL : (byte) (0x80 | eD64FileType_PRG);
+	sectorDirty( track, sector );
+
+	for( chainIT = pFile->mTSChain.begin(); chainIT != pFile->mTSChain.end(); ++chainIT ) {
+		sD64File **owner = &mBamRealTracks[ chainIT->mTrack ][ chainIT->mSector ];
+
+		if( pScratch && *owner == pFile ) {
+			bamSectorMark( chainIT->mTrack, chainIT->mSector, true );
+			*owner = 0;
+
+		} else if( !pScratch && *owner == 0 ) {
+			bamSectorMark( chainIT->mTrack, chainIT->mSector, false );
+			*owner = pFile;
+		}
+	}
+
+	return true;
+}
+
+bool cD64::fileDelete( sD64File *pFile ) {
+
+	if( !fileScratch( pFile, true ) )
+		return false;
+
+	if( !diskWrite() ) {
+		fileScratch( pFile, false );
+		return false;
+	}
+
+	fileRelease( pFile );
+	return true;
+}
+
+void cD64::fileRelease( sD64File *pFile ) {
+	vector< sD64File* >::iterator fileIT = find( mFiles.begin(), mFiles.end(), pFile );
+
+	if( fileIT == mFiles.end() )
+		return;
+
+	mFiles.erase( fileIT );
+	delete pFile;
+}
+
+void cD64::chainFree( vector< sD64Chain > &pChain ) {
+	vector< sD64Chain >::iterator chainIT;
+
+	for( chainIT = pChain.begin(); chainIT != pChain.end(); ++chainIT )
+		bamSectorMark( chainIT->mTrack, chainIT->mSector, true );
+}
+
+// Walk a file chain on first access
+bool cD64::fileExtract( sD64File *pFile ) {
+	
+	if( pFile->mLoaded )
+		return !pFile->mChainBroken;
+
+	pFile->mLoaded = true;
+
+	return fileLoad( pFile );
+}
+
+// Get the file list
+vector< sD64File* > *cD64::directoryGet() {
+	return &mFiles;
+}
+
 // Get a file list, with all files starting with 'pFind'
 vector< sD64File* > cD64::directoryGet( string pFind ) {
 	vector< sD64File* > result;
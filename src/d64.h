@@ -24,6 +24,9 @@
  *  Commodore 64 Disk Image Handling
  *  ------------------------------------------
  */
+
+#define D64_JOURNAL_EXT		".jnl"				// Sectors waiting to be written to an image
+
 enum eD64FileType {
 	eD64FileType_DEL = 0,
 	eD64FileType_SEQ = 1,
@@ -33,7 +36,15 @@ enum eD64FileType {
 	eD64FileType_UNK
 };
 
+enum eD64Problem {
+	eD64Problem_ChainBroken = 0,		// File chain leads off the disk, or loops
+	eD64Problem_CrossLinked,			// Sector used by more than one file
+	eD64Problem_SectorFree,				// Sector used by a file, but free in the BAM
+	eD64Problem_SectorLost				// Sector used in the BAM, but not by any file
+};
+
 struct sD64File;
+class cD64;
 
 struct sD64Chain {
 	size_t		 mTrack, mSector;
@@ -54,6 +65,10 @@ struct sD64File {
 	word	  mFileSize;				// Number of blocks used by file
 	eD64FileType mFileType;				// Type of file
 
+	cD64	*mDisk;						// Disk holding the file
+	bool	 mLoaded;					// Has the chain been walked yet
+	bool	 mView;						// 'mBuffer' points into the disk image, not a copy
+
 	byte	*mBuffer;					// Copy of file
 	size_t	 mBufferSize;				// Size of 'mBuffer'
 
@@ -65,25 +80,55 @@ struct sD64File {
 		mTrack = 0;
 		mSector = 0;
 
+		mDisk = 0;
+		mLoaded = false;
+		mView = false;
+
 		mBuffer = 0;
 		mBufferSize = 0;
 		mFileSize = 0;
 	}
 
 	~sD64File() {						// Destructor
-		delete mBuffer;
+		if( !mView )
+			delete mBuffer;
+	}
+
+	inline byte		*bufferGet();		// File data, extracted on first access
+	inline size_t	 bufferSizeGet();
+};
+
+struct sD64Problem {
+	eD64Problem	 mType;
+	string		 mFile;					// File with the problem, if any
+	string		 mOther;				// File it is cross linked with
+	byte		 mTrack, mSector;
+
+	sD64Problem( eD64Problem pType, string pFile, byte pTrack, byte pSector, string pOther = "" ) {
+		mType = pType;
+		mFile = pFile;
+		mOther = pOther;
+		mTrack = pTrack;
+		mSector = pSector;
 	}
 };
 
 class cD64 {
 private:
-	bool						 mBamTracks[36][24];							// Track/Sector Availability Map (first allocation is ignored
+	dword						 mBamTracks[36];								// Track/Sector Availability Map, one bit per sector, set when free
 	byte						 mBamFree[36];									// Number of free sectors per track
+	size_t						 mBamFreeTotal;									// Number of free sectors on the disk
+
+	static const word			 mTrackOffsets[36];								// First sector of each track in the image
 
 	sD64File					*mBamRealTracks[36][24];						// Information about disk loaded based on files loaded
+	sD64File					 mDirectory;									// Owner of the BAM and directory sectors in 'mBamRealTracks'
+	bool						 mSectorDirty[36][24];							// Sectors changed since the last write
+	bool						 mWriteAll;										// Write the whole image, instead of the changed sectors
 
 	byte						*mBuffer;										// Disk image buffer
 	size_t						 mBufferSize, mTrackCount;
+	bool						 mMapped;										// 'mBuffer' is a read-only mapping of the image
 	
 	bool						 mCreated;										// Was a file created
 	bool						 mRead;											// Disk is read only
@@ -114,45 +159,87 @@ private:
 	sD64File					*directoryEntryLoad( byte *pBuffer );												// Load an entry
 	bool						 directoryAdd( sD64File *pFile );													// Add file to directory
 	bool						 directoryEntrySet( byte pEntryPos, sD64File *pFile, byte *pBuffer );				// Set the directory entry in the buffer
+	byte						*directoryEntryFind( sD64File *pFile, bool pScratched, byte &pTrack, byte &pSector );	// Find the directory entry of a file
+	bool						 fileScratch( sD64File *pFile, bool pScratch );										// Delete or restore a file
+	void						 fileRelease( sD64File *pFile );													// Drop a scratched file from the file list
+	void						 chainFree( vector< sD64Chain > &pChain );											// Free the sectors of a save which did not finish
 	
 	void						 filesCleanup();										// Memory Cleanup
 	bool						 fileLoad( sD64File *pFile );							// Load a file from the disk
 
 	byte						*sectorPtr( dword pTrack, dword pSector );				// Obtain pointer to 'pTrack'/'pSector' in the disk buffer
+	void						 bufferPrivate();										// Copy a mapped image into our own buffer before changing it
+
+	inline void					 sectorDirty( size_t pTrack, size_t pSector ) {			// Mark a sector as needing to be written
+		mSectorDirty[ pTrack ][ pSector ] = true;
+	}
+
+	bool						 sectorsWrite();										// Write the changed sectors, through the journal
+	bool						 journalApply( const byte *pJournal, size_t pSize );	// Write the sectors held in a journal to the image
+	void						 journalReplay();										// Finish a write interrupted by a crash
 
 	inline uint8				 trackRange(const size_t pTrack) const {				// Number of sectors in 'pTrack'
 		return 21 - (pTrack > 17) * 2 - (pTrack > 24) - (pTrack > 30);
 	}
 
+	inline dword				 trackMask(const size_t pTrack) const {				// One bit for each sector in 'pTrack'
+		return (1 << trackRange( pTrack )) - 1;
+	}
+
+	inline size_t				 sectorsTotal() const {								// Number of sectors on the disk
+		return mTrackOffsets[ mTrackCount ] + trackRange( mTrackCount );
+	}
+
 	inline bool					 bamTrackSectorUse( byte pTrack, byte pSector ) {	// Is 'pTrack' / 'pSector' free?
-		if( pTrack == 0 || pTrack > mTrackCount || pSector > trackRange(pTrack) )
+		if( pTrack == 0 || pTrack > mTrackCount || pSector >= trackRange(pTrack) )
 			return false;
 
-		return mBamTracks[ pTrack ][ pSector ];
+		return (mBamTracks[ pTrack ] >> pSector) & 1;
 	}
 
 public:
-								 cD64( string pD64, string pPath, bool pCreate = false, bool pDataSave = false, bool pReadOnly = true );
+								 cD64( string pD64, string pPath, bool pCreate = false, bool pDataSave = false, bool pReadOnly = true, bool pMap = false );
 								~cD64( );
 
 	vector< sD64File* >			 directoryGet( string pFind );		// Get a file list, with all files starting with 'pFind'
 	vector< sD64File* >			*directoryGet();					// Get the file list
 	
 	bool						 diskTest();						// Check a disk for errors
+	bool						 diskCheck( vector< sD64Problem > &pProblems );	// Find damaged files and BAM errors, without repairing them
 	bool						 diskWrite();						// Write the buffer to the D64
 
 	sD64File					*fileGet( string pFilename );		// Get a file
-	bool						 fileSave( string pFilename, byte *pData, size_t pBytes, word pLoadAddress );// Save a file to the disk
+	sD64File					*fileGet( byte pTrack, byte pSector );	// Get the file starting at 'pTrack'/'pSector'
+	bool						 fileExtract( sD64File *pFile );	// Walk a file chain on first access
+	sD64File					*fileSave( string pFilename, byte *pData, size_t pBytes, word pLoadAddress, sD64File *pReplace = 0 );// Save a file to the disk, scratching 'pReplace' in the same write
+	bool						 fileDelete( sD64File *pFile );		// Scratch a file and write the disk, the file is released
 
 	inline size_t				 sectorsFree() {					// Number of free sectors on disk
-		size_t result = 0;
-
-		for(size_t i = 1; i <= mTrackCount; ++i )
-			result += mBamFree[i];
-		return result;
+		return mBamFreeTotal;
 	}
 
 	inline bool					 createdGet() {						// Was file created
 		return mCreated;
 	}
+
+	inline bool					 readyGet() {						// Was the image opened
+		return mReady;
+	}
+
+	inline string				 filenameGet() {					// Name of the D64
+		return mFilename;
+	}
 };
+
+inline byte *sD64File::bufferGet() {
+	if( !mLoaded && mDisk )
+		mDisk->fileExtract( this );
+
+	return mBuffer;
+}
+
+inline size_t sD64File::bufferSizeGet() {
+	bufferGet();
+
+	return mBufferSize;
+}
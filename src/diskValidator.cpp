@@ -0,0 +1,190 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Disk Validator
+ *  ------------------------------------------
+ */
+
+#include "stdafx.h"
+#include "d64.h"
+#include "castle/castle.h"
+#include "diskValidator.h"
+
+static int cDiskValidator_Thread( void *userdata ) {
+	cDiskValidator *validator = (cDiskValidator*) userdata;
+
+	validator->workerThread();
+	return 0;
+}
+
+cDiskValidator::cDiskValidator( string pPath ) {
+	mPath = pPath;
+
+	SDL_AtomicSet( &mNext, 0 );
+}
+
+// Take images off the list until it is empty
+void cDiskValidator::workerThread() {
+
+	for(;;) {
+		size_t next = (size_t) SDL_AtomicAdd( &mNext, 1 );
+
+		if( next >= mDisks.size() )
+			break;
+
+		diskValidate( mDisks[ next ] );
+	}
+}
+
+// One tab separated line: image, result, file, track, sector, detail
+void cDiskValidator::reportAdd( sDiskValidate &pDisk, string pResult, string pFile, int pTrack, int pSector, string pDetail ) {
+	stringstream line;
+
+	line << pDisk.mFilename << "\t" << pResult << "\t" << pFile << "\t";
+
+	if( pTrack >= 0 )
+		line << pTrack;
+	line << "\t";
+
+	if( pSector >= 0 )
+		line << pSector;
+	line << "\t" << pDetail;
+
+	pDisk.mReport.push_back( line.str() );
+}
+
+void cDiskValidator::diskValidate( sDiskValidate &pDisk ) {
+	vector< sD64Problem >				 problems;
+	vector< sD64Problem >::iterator		 problemIT;
+	vector< sD64File* >::iterator		 castleIT;
+	cD64								 disk( pDisk.mFilename, mPath, false, false, true, true );	// Mapped, it is only open while being checked
+
+	if( !disk.readyGet() ) {
+		pDisk.mFailed = true;
+		reportAdd( pDisk, "unreadable" );
+		return;
+	}
+
+	disk.diskCheck( problems );
+
+	for( problemIT = problems.begin(); problemIT != problems.end(); ++problemIT ) {
+
+		switch( problemIT->mType ) {
+			case eD64Problem_ChainBroken:
+				reportAdd( pDisk, "chain-broken", problemIT->mFile, problemIT->mTrack, problemIT->mSector );
+				break;
+
+			case eD64Problem_CrossLinked:
+				reportAdd( pDisk, "cross-linked", problemIT->mFile, problemIT->mTrack, problemIT->mSector, problemIT->mOther );
+				break;
+
+			case eD64Problem_SectorFree:
+				reportAdd( pDisk, "sector-free", problemIT->mFile, problemIT->mTrack, problemIT->mSector );
+				break;
+
+			case eD64Problem_SectorLost:
+				reportAdd( pDisk, "sector-lost", "", problemIT->mTrack, problemIT->mSector );
+				break;
+		}
+	}
+
+	// Castles are the files starting with 'Z', broken chains were reported above
+	vector< sD64File* > castles = disk.directoryGet( "Z" );
+
+	for( castleIT = castles.begin(); castleIT != castles.end(); ++castleIT ) {
+		sD64File	*file = *castleIT;
+		string		 error = "castle file is empty";
+
+		if( file->mChainBroken )
+			continue;
+
+		byte *buffer = file->bufferGet();
+
+		if( !buffer || !cCastle::castleTest( buffer, file->mBufferSize, error ) )
+			reportAdd( pDisk, "castle-invalid", file->mName, file->mTrack, file->mSector, error );
+	}
+
+	pDisk.mFailed = (pDisk.mReport.size() != 0);
+
+	if( !pDisk.mFailed )
+		reportAdd( pDisk, "ok" );
+}
+
+// Check the images across a pool of threads, the report stays in directory order
+bool cDiskValidator::run( string pReportFile ) {
+	vector< string >					 files = directoryListTree( mPath, ".d64", false );
+	vector< string >::iterator			 fileIT;
+	vector< sDiskValidate >::iterator	 diskIT;
+	vector< string >::iterator			 lineIT;
+	vector< SDL_Thread* >				 threads;
+	vector< SDL_Thread* >::iterator		 threadIT;
+	size_t								 failed = 0;
+	Uint32								 start = SDL_GetTicks();
+
+	for( fileIT = files.begin(); fileIT != files.end(); ++fileIT ) {
+		sDiskValidate disk;
+
+		disk.mFilename = *fileIT;
+		disk.mFailed = false;
+
+		mDisks.push_back( disk );
+	}
+
+	size_t count = min( (size_t) max( SDL_GetCPUCount(), 1 ), (size_t) DISK_VALIDATE_THREADS_MAX );
+	count = min( count, mDisks.size() );
+
+	// This thread is one of the workers
+	for( size_t i = 1; i < count; ++i ) {
+		SDL_Thread *thread = SDL_CreateThread( cDiskValidator_Thread, "creep disk validate", this );
+
+		if( thread )
+			threads.push_back( thread );
+	}
+
+	workerThread();
+
+	for( threadIT = threads.begin(); threadIT != threads.end(); ++threadIT )
+		SDL_WaitThread( *threadIT, 0 );
+
+	ofstream report( pReportFile.c_str(), ios::out );
+
+	if( !report.is_open() ) {
+		cout << "Unable to write " << pReportFile << endl;
+		return false;
+	}
+
+	report << "# image\tresult\tfile\ttrack\tsector\tdetail\n";
+
+	for( diskIT = mDisks.begin(); diskIT != mDisks.end(); ++diskIT ) {
+
+		for( lineIT = diskIT->mReport.begin(); lineIT != diskIT->mReport.end(); ++lineIT )
+			report << *lineIT << "\n";
+
+		if( diskIT->mFailed )
+			++failed;
+	}
+
+	report.close();
+
+	cout << " " << mDisks.size() << " images checked in " << (SDL_GetTicks() - start) << "ms, " << failed << " failed" << endl;
+
+	return failed == 0 && !report.fail();
+}
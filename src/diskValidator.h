@@ -0,0 +1,48 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Disk Validator
+ *  ------------------------------------------
+ */
+
+#define DISK_VALIDATE_THREADS_MAX	32				// Most images checked at once
+
+struct sDiskValidate {
+	string				 mFilename;					// Image, relative to the folder being checked
+	vector< string >	 mReport;					// Report lines for the image
+	bool				 mFailed;
+};
+
+class cDiskValidator {
+private:
+	string						 mPath;
+	vector< sDiskValidate >		 mDisks;
+	SDL_atomic_t				 mNext;				// Next image to be checked
+
+	void						 diskValidate( sDiskValidate &pDisk );
+	void						 reportAdd( sDiskValidate &pDisk, string pResult, string pFile = "", int pTrack = -1, int pSector = -1, string pDetail = "" );
+
+public:
+								 cDiskValidator( string pPath );
+
+	bool						 run( string pReportFile );		// Check every image below the folder and write the report, false if any failed
+	void						 workerThread();
+};
@@ -159,6 +159,8 @@ void cWindow::EventCheck() {
 			break;
 		}
 
+		Event.mTimestamp = SysEvent.common.timestamp;
+
 		if (Event.mType != eEvent_None)
 			g_Creep.EventAdd(Event);
 	}
@@ -42,7 +42,11 @@
 // NB! Cutoff frequency characteristics may vary, we have modeled two
 // particular Commodore 64s.
 
-fc_point Filter::f0_points_6581[] =
+sound_sample Filter::f0_6581[2048];
+sound_sample Filter::f0_8580[2048];
+bool Filter::f0_built = false;
+
+const fc_point Filter::f0_points_6581[] =
 {
   //  FC      f         FCHI FCLO
   // ----------------------------
@@ -79,7 +83,7 @@ fc_point Filter::f0_points_6581[] =
   { 2047, 18000 }    // 0xff 0x07 - repeated end point
 };
 
-fc_point Filter::f0_points_8580[] =
+const fc_point Filter::f0_points_8580[] =
 {
   //  FC      f         FCHI FCLO
   // ----------------------------
@@ -110,6 +114,8 @@ fc_point Filter::f0_points_8580[] =
 // ----------------------------------------------------------------------------
 Filter::Filter()
 {
+  f0_own = 0;
+
   fc = 0;
 
   res = 0;
@@ -130,18 +136,33 @@ Filter::Filter()
 
   enable_filter(true);
 
-  // Create mappings from FC to cutoff frequency.
-  interpolate(f0_points_6581, f0_points_6581
-	      + sizeof(f0_points_6581)/sizeof(*f0_points_6581) - 1,
-	      PointPlotter<sound_sample>(f0_6581), 1.0);
-  interpolate(f0_points_8580, f0_points_8580
-	      + sizeof(f0_points_8580)/sizeof(*f0_points_8580) - 1,
-	      PointPlotter<sound_sample>(f0_8580), 1.0);
+  // Create mappings from FC to cutoff frequency, once for all instances.
+  // Filters may be constructed on several threads at once.
+  resid_table_lock(true);
+  if (!f0_built) {
+    interpolate(f0_points_6581, f0_points_6581
+		+ sizeof(f0_points_6581)/sizeof(*f0_points_6581) - 1,
+		PointPlotter<sound_sample>(f0_6581), 1.0);
+    interpolate(f0_points_8580, f0_points_8580
+		+ sizeof(f0_points_8580)/sizeof(*f0_points_8580) - 1,
+		PointPlotter<sound_sample>(f0_8580), 1.0);
+    f0_built = true;
+  }
+  resid_table_lock(false);
 
   set_chip_model(MOS6581);
 }
 
 
+// ----------------------------------------------------------------------------
+// Destructor.
+// ----------------------------------------------------------------------------
+Filter::~Filter()
+{
+  delete[] f0_own;
+}
+
+
 // ----------------------------------------------------------------------------
 // Enable filter.
 // ----------------------------------------------------------------------------
@@ -301,5 +322,18 @@ void Filter::fc_default(const fc_point*& points, int& count)
 // ----------------------------------------------------------------------------
 PointPlotter<sound_sample> Filter::fc_plotter()
 {
-  return PointPlotter<sound_sample>(f0);
+  // The cutoff tables are shared by every instance, so the new mapping is
+  // plotted into a copy of the current one. set_chip_model returns to the
+  // shared tables.
+  if (!f0_own) {
+    f0_own = new sound_sample[2048];
+  }
+  if (f0 != f0_own) {
+    for (int i = 0; i < 2048; i++) {
+      f0_own[i] = f0[i];
+    }
+    f0 = f0_own;
+  }
+
+  return PointPlotter<sound_sample>(f0_own);
 }
@@ -122,6 +122,7 @@ class Filter
 {
 public:
   Filter();
+  ~Filter();
 
   void enable_filter(bool enable);
   void set_chip_model(chip_model model);
@@ -188,12 +189,19 @@ protected:
 
   // Cutoff frequency tables.
   // FC is an 11 bit register.
-  sound_sample f0_6581[2048];
-  sound_sample f0_8580[2048];
-  sound_sample* f0;
-  static fc_point f0_points_6581[];
-  static fc_point f0_points_8580[];
-  fc_point* f0_points;
+  // The tables are built from the spline points by the first Filter, and
+  // shared by every instance after that.
+  static sound_sample f0_6581[2048];
+  static sound_sample f0_8580[2048];
+  // The table lock is held while f0_built is checked and the tables are
+  // built. Instances only read the shared tables; fc_plotter plots into a
+  // copy owned by the instance.
+  static bool f0_built;
+  const sound_sample* f0;
+  sound_sample* f0_own;
+  static const fc_point f0_points_6581[];
+  static const fc_point f0_points_8580[];
+  const fc_point* f0_points;
   int f0_count;
 
 friend class cSID;
@@ -22,6 +22,12 @@
 #include "wave.h"
 #include "voice.h"
 
+#if RESID_SIMD_SSE2
+#include <emmintrin.h>
+#elif RESID_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
 // Moved here by segra to compile with g++
 const int cSID::FIR_N = 125;
 const int cSID::FIR_RES_INTERPOLATE = 285;
@@ -31,6 +37,60 @@ const int cSID::RINGSIZE = 16384;
 const int cSID::FIXP_SHIFT = 16;
 const int cSID::FIXP_MASK = 0xffff;
 
+// Shared FIR tables, see fir_acquire.
+struct cSID::fir_table
+{
+  double clock_freq;
+  sampling_method method;
+  double sample_freq;
+  double pass_freq;
+  double filter_scale;
+
+  int N;
+  int RES;
+  short* fir;
+
+  int refs;
+  fir_table* next;
+};
+
+cSID::fir_table* cSID::fir_tables = 0;
+
+// Lock supplied by the application, guards the shared tables.
+static resid_table_lock_function table_lock = 0;
+
+void cSID::set_table_lock(resid_table_lock_function lock)
+{
+  table_lock = lock;
+}
+
+void resid_table_lock(bool acquire)
+{
+  if (table_lock) {
+    table_lock(acquire);
+  }
+}
+
+// Find a table for these parameters, taking a reference to it.
+// The table lock must be held.
+cSID::fir_table* cSID::fir_find(double clock_freq, sampling_method method,
+				double sample_freq, double pass_freq,
+				double filter_scale)
+{
+  for (fir_table* table = fir_tables; table; table = table->next) {
+    if (table->clock_freq == clock_freq && table->method == method &&
+	table->sample_freq == sample_freq && table->pass_freq == pass_freq &&
+	table->filter_scale == filter_scale)
+    {
+      ++table->refs;
+      return table;
+    }
+  }
+
+  return 0;
+}
+
+
 // ----------------------------------------------------------------------------
 // Constructor.
 // ----------------------------------------------------------------------------
@@ -38,6 +98,9 @@ cSID::cSID()
 {
   // Initialize pointers.
   sample = 0;
+  ring_size = 0;
+  ring_mask = 0;
+  fir_shared = 0;
   fir = 0;
 
   voice[0].set_sync_source(&voice[2]);
@@ -59,7 +122,7 @@ cSID::cSID()
 cSID::~cSID()
 {
   delete[] sample;
-  delete[] fir;
+  fir_release(fir_shared);
 }
 
 
@@ -489,12 +552,65 @@ bool cSID::set_sampling_parameters(double clock_freq, sampling_method method,
   if (method != SAMPLE_RESAMPLE_INTERPOLATE && method != SAMPLE_RESAMPLE_FAST)
   {
     delete[] sample;
-    delete[] fir;
+    fir_release(fir_shared);
     sample = 0;
+    fir_shared = 0;
     fir = 0;
     return true;
   }
 
+  // Use the FIR tables of any instance with the same parameters.
+  fir_table* table =
+    fir_acquire(clock_freq, method, sample_freq, pass_freq, filter_scale);
+  fir_release(fir_shared);
+  fir_shared = table;
+  fir = table->fir;
+  fir_N = table->N;
+  fir_RES = table->RES;
+
+  // Allocate sample buffer, large enough to hold one convolution plus the
+  // previous sample used by interpolation.
+  int size = 1;
+  while (size <= fir_N) {
+    size <<= 1;
+  }
+  if (size != ring_size) {
+    delete[] sample;
+    sample = new short[size*2];
+    ring_size = size;
+    ring_mask = size - 1;
+  }
+  // Clear sample buffer.
+  for (int j = 0; j < ring_size*2; j++) {
+    sample[j] = 0;
+  }
+  sample_index = 0;
+
+  return true;
+}
+
+
+// ----------------------------------------------------------------------------
+// Shared FIR tables.
+// Tables are reference counted, and freed when the last instance using them
+// changes its sampling parameters or is destroyed. Instances on different
+// threads may acquire and release tables at the same time; a table is built
+// outside the lock, and dropped again if another thread added one first.
+// ----------------------------------------------------------------------------
+cSID::fir_table* cSID::fir_acquire(double clock_freq, sampling_method method,
+				   double sample_freq, double pass_freq,
+				   double filter_scale)
+{
+  fir_table* table;
+
+  resid_table_lock(true);
+  table = fir_find(clock_freq, method, sample_freq, pass_freq, filter_scale);
+  resid_table_lock(false);
+
+  if (table) {
+    return table;
+  }
+
   const double pi = 3.1415926535897932385;
 
   // 16 bits -> -96dB stopband attenuation.
@@ -522,7 +638,7 @@ bool cSID::set_sampling_parameters(double clock_freq, sampling_method method,
 
   // The filter length is equal to the filter order + 1.
   // The filter length must be an odd number (sinc is symmetric about x = 0).
-  fir_N = int(N*f_cycles_per_sample) + 1;
+  int fir_N = int(N*f_cycles_per_sample) + 1;
   fir_N |= 1;
 
   // We clamp the filter table resolution to 2^n, making the fixpoint
@@ -531,11 +647,10 @@ bool cSID::set_sampling_parameters(double clock_freq, sampling_method method,
     FIR_RES_INTERPOLATE : FIR_RES_FAST;
 
   int n = (int)ceil(log(res/f_cycles_per_sample)/log(2.0));
-  fir_RES = 1 << n;
+  int fir_RES = 1 << n;
 
   // Allocate memory for FIR tables.
-  delete[] fir;
-  fir = new short[fir_N*fir_RES];
+  short* fir = new short[fir_N*fir_RES];
 
   // Calculate fir_RES FIR tables for linear interpolation.
   for (int i = 0; i < fir_RES; i++) {
@@ -557,17 +672,57 @@ bool cSID::set_sampling_parameters(double clock_freq, sampling_method method,
     }
   }
 
-  // Allocate sample buffer.
-  if (!sample) {
-    sample = new short[RINGSIZE*2];
+  table = new fir_table;
+  table->clock_freq = clock_freq;
+  table->method = method;
+  table->sample_freq = sample_freq;
+  table->pass_freq = pass_freq;
+  table->filter_scale = filter_scale;
+  table->N = fir_N;
+  table->RES = fir_RES;
+  table->fir = fir;
+  table->refs = 1;
+
+  resid_table_lock(true);
+  fir_table* existing =
+    fir_find(clock_freq, method, sample_freq, pass_freq, filter_scale);
+  if (!existing) {
+    table->next = fir_tables;
+    fir_tables = table;
   }
-  // Clear sample buffer.
-  for (int j = 0; j < RINGSIZE*2; j++) {
-    sample[j] = 0;
+  resid_table_lock(false);
+
+  if (existing) {
+    delete[] table->fir;
+    delete table;
+    return existing;
   }
-  sample_index = 0;
 
-  return true;
+  return table;
+}
+
+void cSID::fir_release(fir_table* table)
+{
+  if (!table) {
+    return;
+  }
+
+  resid_table_lock(true);
+  if (--table->refs) {
+    resid_table_lock(false);
+    return;
+  }
+
+  for (fir_table** link = &fir_tables; *link; link = &(*link)->next) {
+    if (*link == table) {
+      *link = table->next;
+      break;
+    }
+  }
+  resid_table_lock(false);
+
+  delete[] table->fir;
+  delete table;
 }
 
 
@@ -840,6 +995,74 @@ int cSID::clock_interpolate(cycle_count& delta_t, short* buf, int n,
 }
 
 
+// ----------------------------------------------------------------------------
+// Convolution of fir_n samples with a FIR table.
+//
+// The vector paths multiply 16 bit pairs into 32 bit sums and accumulate in
+// 32 bits, exactly like the scalar loop, so the result is bit-exact with the
+// scalar reference (build with RESID_NO_SIMD to compare).
+// ----------------------------------------------------------------------------
+RESID_INLINE
+int cSID::fir_convolve(const short* sample_start, const short* fir_start,
+		       int fir_n)
+{
+  int v = 0;
+  int j = 0;
+
+#if RESID_SIMD_SSE2
+  __m128i acc0 = _mm_setzero_si128();
+  __m128i acc1 = _mm_setzero_si128();
+  for (; j + 16 <= fir_n; j += 16) {
+    acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(
+      _mm_loadu_si128((const __m128i*)(sample_start + j)),
+      _mm_loadu_si128((const __m128i*)(fir_start + j))));
+    acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(
+      _mm_loadu_si128((const __m128i*)(sample_start + j + 8)),
+      _mm_loadu_si128((const __m128i*)(fir_start + j + 8))));
+  }
+  for (; j + 8 <= fir_n; j += 8) {
+    acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(
+      _mm_loadu_si128((const __m128i*)(sample_start + j)),
+      _mm_loadu_si128((const __m128i*)(fir_start + j))));
+  }
+  acc0 = _mm_add_epi32(acc0, acc1);
+  acc0 = _mm_add_epi32(acc0, _mm_shuffle_epi32(acc0, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc0 = _mm_add_epi32(acc0, _mm_shuffle_epi32(acc0, _MM_SHUFFLE(2, 3, 0, 1)));
+  v = _mm_cvtsi128_si32(acc0);
+#elif RESID_SIMD_NEON
+  int32x4_t acc = vdupq_n_s32(0);
+  for (; j + 8 <= fir_n; j += 8) {
+    int16x8_t s = vld1q_s16(sample_start + j);
+    int16x8_t f = vld1q_s16(fir_start + j);
+    acc = vmlal_s16(acc, vget_low_s16(s), vget_low_s16(f));
+    acc = vmlal_s16(acc, vget_high_s16(s), vget_high_s16(f));
+  }
+  int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+  v = vget_lane_s32(vpadd_s32(sum, sum), 0);
+#endif
+
+  // Remaining taps, or the whole table for the scalar reference.
+  for (; j < fir_n; j++) {
+    v += sample_start[j]*fir_start[j];
+  }
+
+  return v;
+}
+
+
+// ----------------------------------------------------------------------------
+// SID clocking - 1 cycle, storing the output in the resampling ring.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+void cSID::clock_ring()
+{
+  clock();
+  sample[sample_index] = sample[sample_index + ring_size] = output();
+  ++sample_index;
+  sample_index &= ring_mask;
+}
+
+
 // ----------------------------------------------------------------------------
 // SID clocking with audio sampling - cycle based with audio resampling.
 //
@@ -892,24 +1115,18 @@ int cSID::clock_resample_interpolate(cycle_count& delta_t, short* buf, int n,
       return s;
     }
     for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = output();
-      ++sample_index;
-      sample_index &= 0x3fff;
+      clock_ring();
     }
     delta_t -= delta_t_sample;
     sample_offset = next_sample_offset & FIXP_MASK;
 
     int fir_offset = sample_offset*fir_RES >> FIXP_SHIFT;
     int fir_offset_rmd = sample_offset*fir_RES & FIXP_MASK;
-    short* fir_start = fir + fir_offset*fir_N;
-    short* sample_start = sample + sample_index - fir_N + RINGSIZE;
+    const short* fir_start = fir + fir_offset*fir_N;
+    short* sample_start = sample + sample_index - fir_N + ring_size;
 
     // Convolution with filter impulse response.
-    int v1 = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v1 += sample_start[j]*fir_start[j];
-    }
+    int v1 = fir_convolve(sample_start, fir_start, fir_N);
 
     // Use next FIR table, wrap around to first FIR table using
     // previous sample.
@@ -920,10 +1137,7 @@ int cSID::clock_resample_interpolate(cycle_count& delta_t, short* buf, int n,
     fir_start = fir + fir_offset*fir_N;
 
     // Convolution with filter impulse response.
-    int v2 = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v2 += sample_start[j]*fir_start[j];
-    }
+    int v2 = fir_convolve(sample_start, fir_start, fir_N);
 
     // Linear interpolation.
     // fir_offset_rmd is equal for all samples, it can thus be factorized out:
@@ -945,10 +1159,7 @@ int cSID::clock_resample_interpolate(cycle_count& delta_t, short* buf, int n,
   }
 
   for (int i = 0; i < delta_t; i++) {
-    clock();
-    sample[sample_index] = sample[sample_index + RINGSIZE] = output();
-    ++sample_index;
-    sample_index &= 0x3fff;
+    clock_ring();
   }
   sample_offset -= delta_t << FIXP_SHIFT;
   delta_t = 0;
@@ -975,23 +1186,17 @@ int cSID::clock_resample_fast(cycle_count& delta_t, short* buf, int n,
       return s;
     }
     for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = output();
-      ++sample_index;
-      sample_index &= 0x3fff;
+      clock_ring();
     }
     delta_t -= delta_t_sample;
     sample_offset = next_sample_offset & FIXP_MASK;
 
     int fir_offset = sample_offset*fir_RES >> FIXP_SHIFT;
-    short* fir_start = fir + fir_offset*fir_N;
-    short* sample_start = sample + sample_index - fir_N + RINGSIZE;
+    const short* fir_start = fir + fir_offset*fir_N;
+    short* sample_start = sample + sample_index - fir_N + ring_size;
 
     // Convolution with filter impulse response.
-    int v = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v += sample_start[j]*fir_start[j];
-    }
+    int v = fir_convolve(sample_start, fir_start, fir_N);
 
     v >>= FIR_SHIFT;
 
@@ -1008,10 +1213,7 @@ int cSID::clock_resample_fast(cycle_count& delta_t, short* buf, int n,
   }
 
   for (int i = 0; i < delta_t; i++) {
-    clock();
-    sample[sample_index] = sample[sample_index + RINGSIZE] = output();
-    ++sample_index;
-    sample_index &= 0x3fff;
+    clock_ring();
   }
   sample_offset -= delta_t << FIXP_SHIFT;
   delta_t = 0;
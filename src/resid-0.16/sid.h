@@ -43,6 +43,10 @@ public:
   void fc_default(const fc_point*& points, int& count);
   PointPlotter<sound_sample> fc_plotter();
 
+  // Instances created or changed on more than one thread at once must be
+  // given a lock for the shared tables, before the first instance exists.
+  static void set_table_lock(resid_table_lock_function lock);
+
   void clock();
   void clock(cycle_count delta_t);
   int clock(cycle_count& delta_t, short* buf, int n, int interleave = 1);
@@ -91,6 +95,9 @@ protected:
 			      int interleave);
   RESID_INLINE int clock_interpolate(cycle_count& delta_t, short* buf, int n,
 				     int interleave);
+  static RESID_INLINE int fir_convolve(const short* sample_start,
+				       const short* fir_start, int fir_n);
+  RESID_INLINE void clock_ring();
   RESID_INLINE int clock_resample_interpolate(cycle_count& delta_t, short* buf,
 					      int n, int interleave);
   RESID_INLINE int clock_resample_fast(cycle_count& delta_t, short* buf,
@@ -136,11 +143,28 @@ protected:
   int fir_N;
   int fir_RES;
 
-  // Ring buffer with overflow for contiguous storage of RINGSIZE samples.
+  // Ring buffer with overflow for contiguous storage of ring_size samples.
+  // ring_size is the power of two above fir_N, at most RINGSIZE.
   short* sample;
+  int ring_size;
+  int ring_mask;
 
   // FIR_RES filter tables (FIR_N*FIR_RES).
-  short* fir;
+  // The tables are read only, and shared by every instance using the same
+  // sampling parameters. The list and reference counts are guarded by the
+  // table lock, see fir_acquire.
+  struct fir_table;
+  static fir_table* fir_tables;
+  fir_table* fir_shared;
+  const short* fir;
+
+  static fir_table* fir_acquire(double clock_freq, sampling_method method,
+				double sample_freq, double pass_freq,
+				double filter_scale);
+  static void fir_release(fir_table* table);
+  static fir_table* fir_find(double clock_freq, sampling_method method,
+			     double sample_freq, double pass_freq,
+			     double filter_scale);
 };
 
 #endif // not __SID_H__
@@ -62,8 +62,21 @@ const char* resid_version_string = VERSION;
 #endif
 }
 
+// Lock for the tables shared between instances. It does nothing unless the
+// application supplies a lock with cSID::set_table_lock.
+typedef void (*resid_table_lock_function)(bool acquire);
+void resid_table_lock(bool acquire);
+
 // Inlining on/off.
 #define RESID_INLINING 1
 #define RESID_INLINE inline
 
+// Vectorized FIR convolution for the resampling methods.
+// Define RESID_NO_SIMD to build the scalar reference implementation.
+#if !defined(RESID_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RESID_SIMD_SSE2 1
+#elif !defined(RESID_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define RESID_SIMD_NEON 1
+#endif
+
 #endif // not __SIDDEFS_H__
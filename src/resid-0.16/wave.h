@@ -97,20 +97,20 @@ protected:
   RESID_INLINE reg12 outputNPST();
 
   // Sample data for combinations of waveforms.
-  static reg8 wave6581__ST[];
-  static reg8 wave6581_P_T[];
-  static reg8 wave6581_PS_[];
-  static reg8 wave6581_PST[];
-
-  static reg8 wave8580__ST[];
-  static reg8 wave8580_P_T[];
-  static reg8 wave8580_PS_[];
-  static reg8 wave8580_PST[];
-
-  reg8* wave__ST;
-  reg8* wave_P_T;
-  reg8* wave_PS_;
-  reg8* wave_PST;
+  static const reg8 wave6581__ST[];
+  static const reg8 wave6581_P_T[];
+  static const reg8 wave6581_PS_[];
+  static const reg8 wave6581_PST[];
+
+  static const reg8 wave8580__ST[];
+  static const reg8 wave8580_P_T[];
+  static const reg8 wave8580_PS_[];
+  static const reg8 wave8580_PST[];
+
+  const reg8* wave__ST;
+  const reg8* wave_P_T;
+  const reg8* wave_PS_;
+  const reg8* wave_PST;
 
 friend class Voice;
 friend class cSID;
@@ -19,7 +19,7 @@
 
 #include "wave.h"
 
-reg8 WaveformGenerator::wave6581_PST[] =
+const reg8 WaveformGenerator::wave6581_PST[] =
 {
 /* 0x000: */  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 /* 0x008: */  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
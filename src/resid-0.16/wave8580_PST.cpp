@@ -19,7 +19,7 @@
 
 #include "wave.h"
 
-reg8 WaveformGenerator::wave8580_PST[] =
+const reg8 WaveformGenerator::wave8580_PST[] =
 {
 /* 0x000: */  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 /* 0x008: */  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
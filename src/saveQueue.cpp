@@ -0,0 +1,197 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Background Save Queue
+ *  ------------------------------------------
+ */
+
+#include "stdafx.h"
+#include "castleManager.h"
+#include "saveQueue.h"
+
+int cSaveQueue_WorkerThread( void *userdata ) {
+	cSaveQueue *queue = (cSaveQueue*) userdata;
+
+	return queue->workerThread();
+}
+
+cSaveQueue::cSaveQueue( cCastleManager *pCastleManager ) {
+
+	mCastleManager = pCastleManager;
+
+	mLock = SDL_CreateMutex();
+	mWork = SDL_CreateCond();
+	mSpace = SDL_CreateCond();
+	mRun = true;
+
+	mThread = SDL_CreateThread( cSaveQueue_WorkerThread, "creep saves", this );
+}
+
+// Anything still queued is written before the worker stops
+cSaveQueue::~cSaveQueue() {
+	vector< sSaveJob* >::iterator jobIT;
+
+	SDL_LockMutex( mLock );
+	mRun = false;
+	SDL_CondSignal( mWork );
+	SDL_UnlockMutex( mLock );
+
+	if( mThread )
+		SDL_WaitThread( mThread, 0 );
+
+	for( jobIT = mDone.begin(); jobIT != mDone.end(); ++jobIT )
+		delete *jobIT;
+
+	SDL_DestroyCond( mSpace );
+	SDL_DestroyCond( mWork );
+	SDL_DestroyMutex( mLock );
+}
+
+bool cSaveQueue::jobWrite( sSaveJob *pJob ) {
+	byte *data = pJob->mData.size() ? &pJob->mData[0] : 0;
+
+	if( pJob->mType == eSaveType_Castle )
+		return mCastleManager->castleSave( pJob->mFilename, pJob->mData.size(), data );
+
+	return mCastleManager->positionSave( pJob->mFilename, pJob->mData.size(), data );
+}
+
+// Queue a copy of 'pData'. Saves are written in the order queued, so the last save of a file always wins
+void cSaveQueue::push( eSaveType pType, string pFilename, size_t pSize, const byte *pData, tSaveComplete pComplete, void *pUserData ) {
+	sSaveJob *job = new sSaveJob();
+
+	// C64 filenames are upper case
+	transform( pFilename.begin(), pFilename.end(), pFilename.begin(), ::toupper );
+
+	job->mType = pType;
+	job->mFilename = pFilename;
+	job->mData.assign( pData, pData + pSize );
+	job->mComplete = pComplete;
+	job->mUserData = pUserData;
+	job->mResult = false;
+
+	// Without a worker, write it now
+	if( !mThread ) {
+		job->mResult = jobWrite( job );
+
+		SDL_LockMutex( mLock );
+		mDone.push_back( job );
+		SDL_UnlockMutex( mLock );
+		return;
+	}
+
+	SDL_LockMutex( mLock );
+
+	// Full, wait for the worker to catch up
+	while( mPending.size() >= SAVE_QUEUE_MAX )
+		SDL_CondWait( mSpace, mLock );
+
+	mPending.push_back( job );
+	SDL_CondSignal( mWork );
+
+	SDL_UnlockMutex( mLock );
+}
+
+// Newest queued copy of a file, so a load straight after a save sees it
+bool cSaveQueue::pendingGet( eSaveType pType, string pFilename, byte *pTarget ) {
+	vector< sSaveJob* >::reverse_iterator jobIT;
+	bool result = false;
+
+	transform( pFilename.begin(), pFilename.end(), pFilename.begin(), ::toupper );
+
+	SDL_LockMutex( mLock );
+
+	for( jobIT = mPending.rbegin(); jobIT != mPending.rend(); ++jobIT ) {
+		sSaveJob *job = *jobIT;
+
+		if( job->mType != pType || job->mFilename != pFilename )
+			continue;
+
+		if( job->mData.size() )
+			memcpy( pTarget, &job->mData[0], job->mData.size() );
+
+		result = true;
+		break;
+	}
+
+	SDL_UnlockMutex( mLock );
+	return result;
+}
+
+// Deliver completions, on the thread which queued the saves
+void cSaveQueue::poll() {
+	vector< sSaveJob* >				done;
+	vector< sSaveJob* >::iterator	jobIT;
+
+	SDL_LockMutex( mLock );
+	done.swap( mDone );
+	SDL_UnlockMutex( mLock );
+
+	for( jobIT = done.begin(); jobIT != done.end(); ++jobIT ) {
+		sSaveJob *job = *jobIT;
+
+		if( job->mComplete )
+			job->mComplete( job->mUserData, job->mFilename, job->mResult );
+
+		delete job;
+	}
+}
+
+// Wait for everything queued to be written
+void cSaveQueue::flush() {
+
+	SDL_LockMutex( mLock );
+
+	while( mPending.size() )
+		SDL_CondWait( mSpace, mLock );
+
+	SDL_UnlockMutex( mLock );
+}
+
+int cSaveQueue::workerThread() {
+
+	SDL_LockMutex( mLock );
+
+	for(;;) {
+
+		while( mPending.empty() && mRun )
+			SDL_CondWait( mWork, mLock );
+
+		// Only stop once the queue is empty
+		if( mPending.empty() )
+			break;
+
+		// The job stays at the front while it is written, so pendingGet still finds it
+		sSaveJob *job = mPending.front();
+
+		SDL_UnlockMutex( mLock );
+		job->mResult = jobWrite( job );
+		SDL_LockMutex( mLock );
+
+		mPending.erase( mPending.begin() );
+		mDone.push_back( job );
+
+		SDL_CondBroadcast( mSpace );
+	}
+
+	SDL_UnlockMutex( mLock );
+	return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Background Save Queue
+ *  ------------------------------------------
+ */
+
+#define SAVE_QUEUE_MAX		8					// Saves waiting to be written, before the game thread has to wait
+
+enum eSaveType {
+	eSaveType_Position = 0,						// Save game or high scores, on the save disks
+	eSaveType_Castle							// Castle from the builder, on the castle disks
+};
+
+struct sSaveJob {
+	eSaveType		 mType;
+	string			 mFilename;
+	vector< byte >	 mData;						// Copy of the save block, owned by the job
+	tSaveComplete	 mComplete;
+	void			*mUserData;
+	bool			 mResult;
+};
+
+class cSaveQueue {
+private:
+	cCastleManager			*mCastleManager;
+
+	SDL_Thread				*mThread;
+	SDL_mutex				*mLock;
+	SDL_cond				*mWork;					// Signalled when a save is queued, or the worker is asked to stop
+	SDL_cond				*mSpace;				// Signalled when a save has been written
+	bool					 mRun;
+
+	vector< sSaveJob* >		 mPending;				// Oldest first, the front is being written
+	vector< sSaveJob* >		 mDone;					// Written, waiting for their completion to be delivered
+
+	bool					 jobWrite( sSaveJob *pJob );
+
+public:
+							 cSaveQueue( cCastleManager *pCastleManager );
+							~cSaveQueue();
+
+	void					 push( eSaveType pType, string pFilename, size_t pSize, const byte *pData, tSaveComplete pComplete, void *pUserData );
+	bool					 pendingGet( eSaveType pType, string pFilename, byte *pTarget );	// Newest queued copy of a file
+	void					 poll();				// Deliver completions on the calling thread
+	void					 flush();				// Wait for everything queued to be written
+
+	int						 workerThread();
+};
@@ -0,0 +1,98 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Audio Ring Buffer
+ *  ------------------------------------------
+ */
+
+#include "stdafx.h"
+#include "audioRing.h"
+
+cAudioRing::cAudioRing( dword pSize ) {
+
+	// Round up to a power of two, so positions can be masked
+	mSize = 1;
+	while( mSize < pSize )
+		mSize <<= 1;
+
+	mMask = mSize - 1;
+	mBuffer = new short[ mSize ];
+
+	reset();
+}
+
+cAudioRing::~cAudioRing() {
+
+	delete[] mBuffer;
+}
+
+void cAudioRing::reset() {
+
+	memset( mBuffer, 0, mSize * sizeof( short ) );
+
+	SDL_AtomicSet( &mRead, 0 );
+	SDL_AtomicSet( &mWrite, 0 );
+}
+
+dword cAudioRing::freeGet() {
+
+	return mSize - usedGet();
+}
+
+dword cAudioRing::usedGet() {
+
+	return (dword) SDL_AtomicGet( &mWrite ) - (dword) SDL_AtomicGet( &mRead );
+}
+
+dword cAudioRing::write( const short *pSamples, dword pCount ) {
+	dword position = (dword) SDL_AtomicGet( &mWrite );
+	dword count = min( pCount, freeGet() );
+
+	// Copy in up to two pieces, either side of the end of the buffer
+	dword first = min( count, mSize - (position & mMask) );
+
+	memcpy( &mBuffer[ position & mMask ], pSamples, first * sizeof( short ) );
+	memcpy( mBuffer, pSamples + first, (count - first) * sizeof( short ) );
+
+	// Samples must be visible before the consumer sees the new position
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet( &mWrite, (int) (position + count) );
+
+	return count;
+}
+
+dword cAudioRing::read( short *pSamples, dword pCount ) {
+	dword position = (dword) SDL_AtomicGet( &mRead );
+	dword count = min( pCount, usedGet() );
+
+	SDL_MemoryBarrierAcquire();
+
+	dword first = min( count, mSize - (position & mMask) );
+
+	memcpy( pSamples, &mBuffer[ position & mMask ], first * sizeof( short ) );
+	memcpy( pSamples + first, mBuffer, (count - first) * sizeof( short ) );
+
+	// The producer may reuse the space once the position moves
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet( &mRead, (int) (position + count) );
+
+	return count;
+}
@@ -0,0 +1,54 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Audio Ring Buffer
+ *  ------------------------------------------
+ */
+
+// Single producer / single consumer ring of samples. The producer only moves the
+// write position and the consumer only the read position, so neither side locks.
+// Positions count up forever, and are masked into the buffer when accessed
+class cAudioRing {
+
+private:
+	short			*mBuffer;
+	dword			 mSize, mMask;
+
+	SDL_atomic_t	 mRead, mWrite;
+
+public:
+
+	 cAudioRing( dword pSize );
+	~cAudioRing();
+
+	// Producer
+	dword			 freeGet();
+	dword			 write( const short *pSamples, dword pCount );
+
+	// Consumer
+	dword			 usedGet();
+	dword			 read( short *pSamples, dword pCount );
+
+	// Only safe while neither side is running
+	void			 reset();
+
+	inline dword	 sizeGet() { return mSize; }
+};
@@ -0,0 +1,123 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Audio Statistics
+ *  ------------------------------------------
+ */
+
+#include "stdafx.h"
+#include "audioStats.h"
+
+void sAudioHistogram::add( dword pValue ) {
+	size_t bucket = 0;
+
+	while( bucket < AUDIO_STATS_BUCKETS - 1 && (pValue >> bucket) )
+		++bucket;
+
+	SDL_AtomicAdd( &mBuckets[bucket], 1 );
+
+	for(;;) {
+		int max = SDL_AtomicGet( &mMax );
+
+		if( pValue <= (dword) max || SDL_AtomicCAS( &mMax, max, pValue ) )
+			break;
+	}
+}
+
+// Percentiles are the upper bound of the bucket they fall in
+void sAudioHistogram::take( dword &pCount, dword &pP50, dword &pP99, dword &pMax ) {
+	dword counts[ AUDIO_STATS_BUCKETS ];
+
+	pCount = 0;
+	for( size_t bucket = 0; bucket < AUDIO_STATS_BUCKETS; ++bucket )
+		pCount += counts[bucket] = SDL_AtomicSet( &mBuckets[bucket], 0 );
+
+	pMax = SDL_AtomicSet( &mMax, 0 );
+	pP50 = pP99 = 0;
+
+	dword total = 0;
+	for( size_t bucket = 0; bucket < AUDIO_STATS_BUCKETS && pCount; ++bucket ) {
+		total += counts[bucket];
+
+		if( !pP50 && total * 2 >= pCount )
+			pP50 = 1 << bucket;
+
+		if( total * 100 >= pCount * 99 ) {
+			pP99 = 1 << bucket;
+			break;
+		}
+	}
+}
+
+cAudioStats::cAudioStats() {
+
+	memset( this, 0, sizeof( cAudioStats ) );
+}
+
+void cAudioStats::renderRecord( dword pMicroseconds, dword pSamples, dword pCycles ) {
+
+	mRenderTime.add( pMicroseconds );
+
+	SDL_AtomicAdd( &mRenders, 1 );
+	SDL_AtomicAdd( &mRenderSamples, pSamples );
+	SDL_AtomicAdd( &mRenderCycles, pCycles );
+}
+
+void cAudioStats::callbackRecord( dword pMicroseconds, dword pDepth, dword pMissing ) {
+
+	mCallbackTime.add( pMicroseconds );
+	mRingDepth.add( pDepth );
+
+	SDL_AtomicAdd( &mCallbacks, 1 );
+
+	if( pMissing ) {
+		SDL_AtomicAdd( &mUnderruns, 1 );
+		SDL_AtomicAdd( &mUnderrunSamples, pMissing );
+	}
+}
+
+string cAudioStats::reportTake() {
+	stringstream report;
+	dword count, p50, p99, max;
+
+	dword renders = SDL_AtomicSet( &mRenders, 0 );
+	dword samples = SDL_AtomicSet( &mRenderSamples, 0 );
+	dword cycles = SDL_AtomicSet( &mRenderCycles, 0 );
+
+	mRenderTime.take( count, p50, p99, max );
+	report << renders << " renders (p50 <" << p50 << "us, p99 <" << p99 << "us, max " << max << "us";
+	if( renders )
+		report << ", " << (samples / renders) << " samples, " << (cycles / renders) << " cycles";
+	report << "), ";
+
+	dword callbacks = SDL_AtomicSet( &mCallbacks, 0 );
+	dword underruns = SDL_AtomicSet( &mUnderruns, 0 );
+	dword missing = SDL_AtomicSet( &mUnderrunSamples, 0 );
+
+	mCallbackTime.take( count, p50, p99, max );
+	report << callbacks << " callbacks (p50 <" << p50 << "us, p99 <" << p99 << "us, max " << max << "us), ";
+	report << underruns << " underruns (" << missing << " samples), ";
+
+	mRingDepth.take( count, p50, p99, max );
+	report << "ring p50 <" << p50 << " samples";
+
+	return report.str();
+}
@@ -0,0 +1,54 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Audio Statistics
+ *  ------------------------------------------
+ */
+
+// Histogram buckets are powers of two, bucket n holds values below 2^n
+#define AUDIO_STATS_BUCKETS		24
+
+// Written by the audio thread and the device callback, read and reset by the game thread
+struct sAudioHistogram {
+	SDL_atomic_t	 mBuckets[ AUDIO_STATS_BUCKETS ];
+	SDL_atomic_t	 mMax;
+
+	void			 add( dword pValue );
+	void			 take( dword &pCount, dword &pP50, dword &pP99, dword &pMax );
+};
+
+class cAudioStats {
+
+private:
+	sAudioHistogram	 mRenderTime, mCallbackTime, mRingDepth;
+
+	SDL_atomic_t	 mRenders, mRenderSamples, mRenderCycles;
+	SDL_atomic_t	 mCallbacks, mUnderruns, mUnderrunSamples;
+
+public:
+
+	 cAudioStats();
+
+	void			 renderRecord( dword pMicroseconds, dword pSamples, dword pCycles );	// Audio thread
+	void			 callbackRecord( dword pMicroseconds, dword pDepth, dword pMissing );	// Device callback
+
+	string			 reportTake();		// Everything since the last report, as one line
+};
@@ -0,0 +1,135 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Sound Effect Mixer
+ *  ------------------------------------------
+ */
+
+#include "stdafx.h"
+#include "effectMixer.h"
+
+cEffectMixer::cEffectMixer() {
+
+	SDL_AtomicSet( &mReady, 0 );
+	mStarts = 0;
+
+	for( byte voice = 0; voice < SOUND_EFFECT_VOICES; ++voice )
+		mVoices[voice].mActive = false;
+
+	for( byte effect = 0; effect < SOUND_EFFECTS; ++effect )
+		SDL_AtomicSet( &mPending[effect], 0 );
+}
+
+void cEffectMixer::bankSet( byte pEffect, vector< short > &pSamples ) {
+
+	if( pEffect < SOUND_EFFECTS )
+		mBank[pEffect].swap( pSamples );
+}
+
+// Publish the bank, the writes filling it must be visible before the callback sees it ready
+void cEffectMixer::bankReady() {
+
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet( &mReady, 1 );
+}
+
+void cEffectMixer::play( byte pEffect ) {
+
+	if( pEffect < SOUND_EFFECTS && !mBank[pEffect].empty() )
+		SDL_AtomicAdd( &mPending[pEffect], 1 );
+}
+
+// Take a free voice, unless this effect is already playing in every voice it may have, then restart its oldest
+void cEffectMixer::voiceStart( byte pEffect ) {
+	sEffectVoice *free = 0, *oldest = 0, *oldestSame = 0;
+	byte instances = 0;
+
+	for( byte count = 0; count < SOUND_EFFECT_VOICES; ++count ) {
+		sEffectVoice *voice = &mVoices[count];
+
+		if( !voice->mActive ) {
+			if( !free )
+				free = voice;
+			continue;
+		}
+
+		if( !oldest || voice->mStarted < oldest->mStarted )
+			oldest = voice;
+
+		if( voice->mEffect == pEffect ) {
+			++instances;
+
+			if( !oldestSame || voice->mStarted < oldestSame->mStarted )
+				oldestSame = voice;
+		}
+	}
+
+	sEffectVoice *voice = free ? free : oldest;
+	if( instances >= SOUND_EFFECT_INSTANCES )
+		voice = oldestSame;
+
+	voice->mActive = true;
+	voice->mEffect = pEffect;
+	voice->mPosition = 0;
+	voice->mStarted = mStarts++;
+}
+
+// Add the playing effects onto the buffer, with saturation
+void cEffectMixer::mix( short *pBuffer, dword pSamples ) {
+
+	if( !SDL_AtomicGet( &mReady ) )
+		return;
+
+	SDL_MemoryBarrierAcquire();
+
+	for( byte effect = 0; effect < SOUND_EFFECTS; ++effect ) {
+		int starts = SDL_AtomicSet( &mPending[effect], 0 );
+
+		while( starts-- )
+			voiceStart( effect );
+	}
+
+	for( byte count = 0; count < SOUND_EFFECT_VOICES; ++count ) {
+		sEffectVoice *voice = &mVoices[count];
+
+		if( !voice->mActive )
+			continue;
+
+		const vector< short > &bank = mBank[ voice->mEffect ];
+		dword samples = min( pSamples, (dword) bank.size() - voice->mPosition );
+		const short *source = &bank[ voice->mPosition ];
+
+		for( dword sample = 0; sample < samples; ++sample ) {
+			int value = pBuffer[sample] + source[sample];
+
+			if( value > 0x7FFF )
+				value = 0x7FFF;
+			else if( value < -0x8000 )
+				value = -0x8000;
+
+			pBuffer[sample] = (short) value;
+		}
+
+		voice->mPosition += samples;
+		if( voice->mPosition == bank.size() )
+			voice->mActive = false;
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ *  The Castles of Dr. Creep 
+ *  ------------------------
+ *
+ *  Copyright (C) 2009-2016 Robert Crossfield
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  ------------------------------------------
+ *  Sound Effect Mixer
+ *  ------------------------------------------
+ */
+
+#define SOUND_EFFECTS			13		// SOUND_LASER_FIRED to SOUND_KEY_PICKUP
+#define SOUND_EFFECT_VOICES		8		// Effects mixed at once
+#define SOUND_EFFECT_INSTANCES	2		// Copies of one effect mixed at once, the oldest is restarted beyond this
+#define SOUND_EFFECT_SECONDS	10		// Longest effect kept in the bank
+
+struct sEffectVoice {
+	bool			 mActive;
+	byte			 mEffect;
+	dword			 mPosition;
+	dword			 mStarted;			// Start order, for restarting the oldest
+};
+
+// Sound effects rendered once through the SID, mixed over the music by the device callback.
+// The bank is filled before any effect is played, and only read after that
+class cEffectMixer {
+
+private:
+	vector< short >	 mBank[ SOUND_EFFECTS ];
+	SDL_atomic_t	 mReady;			// Set once the bank is filled, read by the device callback
+
+	sEffectVoice	 mVoices[ SOUND_EFFECT_VOICES ];
+	dword			 mStarts;
+
+	SDL_atomic_t	 mPending[ SOUND_EFFECTS ];	// Started by the game, not yet picked up by the callback
+
+	void			 voiceStart( byte pEffect );
+
+public:
+
+	 cEffectMixer();
+
+	void			 bankSet( byte pEffect, vector< short > &pSamples );	// Takes the samples
+	void			 bankReady();
+	inline bool		 readyGet() { return SDL_AtomicGet( &mReady ) != 0; }
+
+	void			 play( byte pEffect );								// Game thread
+	void			 mix( short *pBuffer, dword pSamples );				// Device callback
+};
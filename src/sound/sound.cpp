@@ -27,31 +27,113 @@
 #include "sound.h"
 #include "creep.h"
 #include "resid-0.16/sid.h"
+#include "audioRing.h"
+#include "audioStats.h"
+#include "effectMixer.h"
 
 // Call back from Audio Device to fill audio output buffer
 void cSound_AudioCallback(void *userdata, Uint8 *stream, int len) {
 	cSound  *sound = (cSound*) userdata;
 
-	sound->audioBufferFill( (short*) stream, len );
+	sound->audioBufferCopy( (short*) stream, len );
 }
 
-// Constructor, prepare the SID
-cSound::cSound( cCreep *pCreep ) {
+// Audio thread, renders the music ahead of the device
+int cSound_AudioThread( void *userdata ) {
+	cSound  *sound = (cSound*) userdata;
+
+	return sound->audioThread();
+}
+
+// Guards the reSID tables shared between SIDs, the game thread creates SIDs while the audio thread renders
+static SDL_mutex *gSIDTableLock = 0;
+
+static void cSound_SIDTableLock( bool pAcquire ) {
+
+	if( pAcquire )
+		SDL_LockMutex( gSIDTableLock );
+	else
+		SDL_UnlockMutex( gSIDTableLock );
+}
+
+// A completed pass of music, owned by the cache writer thread
+struct sMusicCacheWrite {
+	string				 mName;
+	sMusicCacheHeader	 mHeader;
+	vector< short >		 mSamples;
+	SDL_atomic_t		*mWriting;
+};
+
+// Cache writer thread, storage may be too slow to write from the audio thread
+int cSound_CacheWriter( void *userdata ) {
+	sMusicCacheWrite *write = (sMusicCacheWrite*) userdata;
+	vector< byte > buffer( sizeof( sMusicCacheHeader ) + (write->mSamples.size() * sizeof( short )) );
+
+	memcpy( &buffer[0], &write->mHeader, sizeof( sMusicCacheHeader ) );
+	memcpy( &buffer[ sizeof( sMusicCacheHeader ) ], &write->mSamples[0], write->mSamples.size() * sizeof( short ) );
+
+	local_DirectoryCreate( MUSIC_CACHE_PATH, false );
+
+	if( !local_FileSave( write->mName, MUSIC_CACHE_PATH, false, &buffer[0], buffer.size() ) )
+		cout << "Music cache: unable to write " << write->mName << endl;
+
+	SDL_AtomicSet( write->mWriting, 0 );
+	delete write;
+	return 0;
+}
+
+// Constructor, prepare the SID, and the audio device unless only rendering to a file
+cSound::cSound( cCreep *pCreep, bool pDevice, dword pRate, dword pFrames ) {
 
 	mCreep = pCreep;
 
-	mCyclesRemaining = 0;
+	mCiaCycles = 0;
 	mFinalCount = 0;
-	mTicks = 0;
+
+	mStats = new cAudioStats();
+	mEffects = new cEffectMixer();
+	mIdleLevel = 0;
+	mCyclesClocked = 0;
+
+	mRing = 0;
+	mRender = 0;
+	mRenderSize = 0;
+	mThread = 0;
+	mLock = SDL_CreateMutex();
+	mRingSpace = SDL_CreateSemaphore( 0 );
+	SDL_AtomicSet( &mRingWaiting, 0 );
+	SDL_AtomicSet( &mThreadRun, 0 );
+
+	mCacheSourceSize = mCacheSourceHash = 0;
+	mCacheCapturing = mCacheComplete = false;
+	mCacheMap = 0;
+	mCacheMapSize = 0;
+	mCacheSamples = 0;
+	mCacheCount = mCachePosition = 0;
+	mCacheWriter = 0;
+	SDL_AtomicSet( &mCacheWriting, 0 );
+	mAudioSpec = 0;
+	mDevice = 0;
+	mSampleRate = pRate;
+
+	mQualityFixed = false;
+	mQualityLoad = 0;
+	mQualityPasses = 0;
+	mQualityCalm = 0;
+	mQualityBackoff = 1;
+
+	// The first cSound is made before any audio thread, only the game thread makes them
+	if( !gSIDTableLock ) {
+		gSIDTableLock = SDL_CreateMutex();
+		cSID::set_table_lock( cSound_SIDTableLock );
+	}
 
 	// Prepare the SID
 	mSID = new cSID();
+	mSIDResample = 0;
 
-	// Set the sampling parameters, PAL, at a rate of 44100Hz
-	//mSID->set_sampling_parameters(985248, SAMPLE_FAST, 22050 );
-	// 1022727.1428571428
-	//
-  	mSID->enable_filter(false);
+	// Start at the cheapest quality, PAL, at a rate of 44100Hz
+	qualityApply( eSoundQuality_Fast );
   
   	mSID->reset();
 
@@ -63,63 +145,266 @@ cSound::cSound( cCreep *pCreep ) {
   	mSID->write(11, 0x00);
   	mSID->write(18, 0x00);
 
-	mVal = 0;
-
-	devicePrepare();
+	if( pDevice && devicePrepare( pRate, pFrames ) )
+		threadStart();
 }
 
 cSound::~cSound() {
 
-	SDL_CloseAudio();
+	if( mDevice )
+		SDL_CloseAudioDevice( mDevice );
+
+	threadStop();
+	musicCacheStop();
+	musicCacheWait();
+
+	delete mSIDResample;
+
 	delete mAudioSpec;
+	delete mRing;
+	delete mStats;
+	delete mEffects;
+	delete[] mRender;
+
+	SDL_DestroySemaphore( mRingSpace );
+	SDL_DestroyMutex( mLock );
+}
+
+// Size the ring from the negotiated device buffer, and start rendering
+void cSound::threadStart() {
+
+	// Render one device buffer per pass, and keep up to two queued
+	mRenderSize = mAudioSpec->samples;
+	mRender = new short[ mRenderSize ];
+	mRing = new cAudioRing( mRenderSize * 2 );
+
+	cout << "Audio: " << mAudioSpec->freq << "Hz, " << (int) mAudioSpec->channels << " channels, " << mAudioSpec->samples << " frames";
+	cout << " (" << (mAudioSpec->samples * 1000.0 / mAudioSpec->freq) << "ms device buffer, ";
+	cout << (mRing->sizeGet() * 1000.0 / mSampleRate) << "ms queued at most)" << endl;
+
+	// Build the resampling FIR table here, stepping up to it on the audio thread then only takes a reference
+	mSIDResample = new cSID();
+	mSIDResample->set_sampling_parameters( SOUND_CLOCK_PAL, SAMPLE_RESAMPLE_INTERPOLATE, mSampleRate );
+
+	SDL_AtomicSet( &mThreadRun, 1 );
+	mThread = SDL_CreateThread( cSound_AudioThread, "creep audio", this );
+}
+
+void cSound::threadStop() {
+
+	if( !mThread )
+		return;
+
+	SDL_AtomicSet( &mThreadRun, 0 );
+	SDL_SemPost( mRingSpace );
+
+	SDL_WaitThread( mThread, 0 );
+	mThread = 0;
+}
+
+int cSound::audioThread() {
+
+	while( SDL_AtomicGet( &mThreadRun ) ) {
+
+		// Wait for the device to free some space
+		if( mRing->freeGet() < mRenderSize ) {
+
+			// Drop any wakeup left from a wait which ended without it
+			while( SDL_SemTryWait( mRingSpace ) == 0 )
+				;
+
+			SDL_AtomicSet( &mRingWaiting, 1 );
+
+			// The device may have taken samples before it could see the flag
+			if( mRing->freeGet() < mRenderSize )
+				SDL_SemWaitTimeout( mRingSpace, 10 );
+
+			SDL_AtomicSet( &mRingWaiting, 0 );
+			continue;
+		}
+
+		lock();
+		Uint64 start = SDL_GetPerformanceCounter();
+
+		mCyclesClocked = 0;
+		audioBufferFill( mRender, mRenderSize * sizeof( short ) );
+
+		double elapsed = (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+		mStats->renderRecord( (dword) (elapsed * 1000000), mRenderSize, mCyclesClocked );
+
+		// Fraction of the time this pass plays for, that was spent rendering it
+		double load = elapsed * mSampleRate / mRenderSize;
+
+		qualityUpdate( load );
+
+		mRing->write( mRender, mRenderSize );
+		unlock();
+
+		// Handed to the writer outside the lock, once the last pass has been written
+		if( mCacheComplete && !SDL_AtomicGet( &mCacheWriting ) )
+			musicCacheSave();
+	}
+
+	return 0;
+}
+
+// Copy out whatever has been rendered, an underrun plays silence
+void cSound::audioBufferCopy( short *pBuffer, int pBufferSize ) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	dword channels = mAudioSpec->channels;
+	dword samples = pBufferSize / (sizeof( short ) * channels);
+	dword count = 0, depth = 0;
+
+	if( mRing ) {
+		depth = mRing->usedGet();
+		count = mRing->read( pBuffer, samples );
+	}
+
+	if( count < samples )
+		memset( pBuffer + count, 0, (samples - count) * sizeof( short ) );
+
+	// Wake the producer, only if it is waiting
+	if( SDL_AtomicCAS( &mRingWaiting, 1, 0 ) )
+		SDL_SemPost( mRingSpace );
+
+	mEffects->mix( pBuffer, samples );
+
+	// The SID is mono, spread each sample across the device channels (from the end, in place)
+	if( channels > 1 ) {
+		for( dword sample = samples; sample--; ) {
+			for( dword channel = 0; channel < channels; ++channel )
+				pBuffer[ (sample * channels) + channel ] = pBuffer[ sample ];
+		}
+	}
+
+	Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+	mStats->callbackRecord( (dword) (elapsed * 1000000 / SDL_GetPerformanceFrequency()), depth, samples - count );
 }
 
 void cSound::audioBufferFill( short *pBuffer, int pBufferSize ) {
-	byte *musicBuffer = mCreep->musicBufferGet();
 	memset( pBuffer, 0, pBufferSize );
 
 	// Convert buffer size in bytes, to the size in words (each sample is 1 word)
 	int samplesRemaining = (pBufferSize / 2);
 
+	// Music is already rendered
+	if( mCacheSamples ) {
+		musicCacheFill( pBuffer, samplesRemaining );
+		return;
+	}
+
+	// Nothing has been sequenced for a while, hold the level the SID went quiet at rather than clocking it
+	if( !mCreep->musicBufferGet() && mFinalCount > SOUND_IDLE_TICKS ) {
+		for( int sample = 0; sample < samplesRemaining; ++sample )
+			pBuffer[sample] = mIdleLevel;
+		return;
+	}
+
 	// Loop for required number of samples to fill buffer
 	while (samplesRemaining > 0) {
 
-		// CIA Timer Fired?
-		//if(mTicks <= 0) {
+		// CIA Timer A underflow, run the music interrupt and reload the timer from its latch
+		if( mCiaCycles <= 0 ) {
 
-			// buffer to load?
-			if( musicBuffer ) {
+			if( mCreep->musicBufferGet() ) {
 				// Update the music buffer feed and update the SID
 				mCreep->musicBufferFeed();
 			} else
-				if(!mCyclesRemaining)
-					++mFinalCount;
-
-			// Reload the new ptr
-			musicBuffer = mCreep->musicBufferGet();
+				++mFinalCount;
 
-			// Reload the CIA Timer
-		//	mTicks = (*mCreep->memory(0xDC05));
-		//}
+			// The interrupt may have changed the tempo
+			mCiaCycles += ciaPeriodGet();
+		}
 
-		// Time for video frame update?
-  		if (mCyclesRemaining <= 0) {
-			mCyclesRemaining =  (g_Creep.mTimerGet() * 60 ) * 6;
+		// Clock the SID up to the next underflow, or until the buffer is full
+		int cycles = mCiaCycles;
+		int sampleCount = mSID->clock(mCiaCycles, pBuffer, samplesRemaining);
+		mCyclesClocked += cycles - mCiaCycles;
 
-			/*mCyclesRemaining = 0x4CC8 * 2;*/
-  		}
-
-  		// Clock the SID for 'samplesRemaining', only will do all if there is enough cpu cycles remaining
-  		int sampleCount = mSID->clock(mCyclesRemaining, pBuffer, samplesRemaining);
-	
-		//mTicks -= sampleCount;
+		if( mCacheCapturing )
+			mCacheCapture.insert( mCacheCapture.end(), pBuffer, pBuffer + sampleCount );
 
 		// Decrease number of samples remaining by the number of samples just calculated
-  		samplesRemaining -= sampleCount;
+		samplesRemaining -= sampleCount;
 
 		// Increase buffer by the number of samples just calculated
-  		pBuffer += sampleCount;
-  	}
+		pBuffer += sampleCount;
+	}
+
+	mIdleLevel = pBuffer[-1];
+}
+
+// Cycles between CIA Timer A underflows. The game only writes the latch high byte ($DC05), the low byte ($DC04)
+// keeps the value the KERNAL set at power on. The timer counts down to zero, then reloads on the next cycle
+int cSound::ciaPeriodGet() {
+
+	return ((g_Creep.mTimerGet() << 8) | SOUND_CIA_LATCH_LO) + 1;
+}
+
+// Set the reSID sampling method and filter for a quality level, the lock must be held
+void cSound::qualityApply( eSoundQuality pQuality ) {
+	static const sampling_method methods[] = { SAMPLE_FAST, SAMPLE_FAST, SAMPLE_INTERPOLATE, SAMPLE_RESAMPLE_INTERPOLATE };
+
+	mQuality = pQuality;
+	mQualityLoad = 0;
+	mQualityPasses = 0;
+
+	// A cache pass must be rendered at one level throughout
+	mCacheCapturing = false;
+	mCacheCapture.clear();
+
+	mSID->set_sampling_parameters( SOUND_CLOCK_PAL, methods[pQuality], mSampleRate );
+	mSID->enable_filter( pQuality != eSoundQuality_Fast );
+}
+
+// Step the quality down as soon as rendering gets close to the device, step up only after a long quiet spell
+void cSound::qualityUpdate( double pLoad ) {
+
+	if( mQualityFixed )
+		return;
+
+	mQualityLoad = mQualityPasses ? (mQualityLoad * 0.875) + (pLoad * 0.125) : pLoad;
+
+	if( mQuality > eSoundQuality_Fast && (mQualityLoad > SOUND_QUALITY_LOAD_HIGH || pLoad > SOUND_QUALITY_LOAD_PEAK) ) {
+
+		// This level could not be held, wait longer before trying it again
+		if( mQualityBackoff < SOUND_QUALITY_BACKOFF_MAX )
+			mQualityBackoff <<= 1;
+
+		mQualityCalm = 0;
+		qualityApply( (eSoundQuality) (mQuality - 1) );
+		return;
+	}
+
+	if( pLoad >= SOUND_QUALITY_LOAD_LOW ) {
+		mQualityPasses = 1;
+		mQualityCalm = 0;
+		return;
+	}
+
+	// Passes play for mRenderSize samples each
+	dword passesPerSecond = max( mSampleRate / max( mRenderSize, (dword) 1 ), (dword) 1 );
+
+	// A long quiet spell, so earlier stalls were likely passing load
+	if( ++mQualityCalm >= SOUND_QUALITY_SECONDS_CALM * passesPerSecond ) {
+		mQualityCalm = 0;
+
+		if( mQualityBackoff > 1 )
+			mQualityBackoff >>= 1;
+	}
+
+	if( ++mQualityPasses >= SOUND_QUALITY_SECONDS_UP * passesPerSecond * mQualityBackoff && mQuality < eSoundQuality_Max )
+		qualityApply( (eSoundQuality) (mQuality + 1) );
+}
+
+void cSound::qualitySet( eSoundQuality pQuality, bool pFixed ) {
+
+	lock();
+	mQualityFixed = pFixed;
+	mQualityBackoff = 1;
+	mQualityCalm = 0;
+	qualityApply( pQuality );
+	unlock();
 }
 
 // Write to the SID Registers
@@ -127,49 +412,359 @@ void cSound::sidWrite( byte pRegister, byte pValue ) {
 	mSID->write( pRegister, pValue );
 }
 
-// Prepare the local audio device
-bool cSound::devicePrepare() {
-	SDL_AudioSpec *desired;
+// Open the audio device, letting it change the rate and buffer size to what it prefers
+bool cSound::devicePrepare( dword pRate, dword pFrames ) {
+	SDL_AudioSpec desired;
 
-	desired = new SDL_AudioSpec();
+	memset( &desired, 0, sizeof( desired ) );
 	mAudioSpec = new SDL_AudioSpec();
 
-	// FM Quality, 16Bit Signed, Mono
-	desired->freq=22050;
-	desired->format=AUDIO_S16LSB;
-	desired->channels=2;
-
-	// 2048 Samples, at 2 bytes per sample
-	desired->samples=0x400;
+	desired.freq = pRate;
+	desired.format = AUDIO_S16SYS;
+	desired.channels = 2;
+	desired.samples = (Uint16) min( max( pFrames, (dword) SOUND_FRAMES_MIN ), (dword) SOUND_FRAMES_MAX );
 
 	// Function to call when the audio playback buffer is empty
-	desired->callback = cSound_AudioCallback;
+	desired.callback = cSound_AudioCallback;
 
 	// Pass a ptr to this class
-	desired->userdata = this;
-
-	// Open the audio device
-	mVal = SDL_OpenAudio(desired, mAudioSpec);
+	desired.userdata = this;
 
-	delete desired;
+	// Open the audio device, the sample format must stay as requested
+	mDevice = SDL_OpenAudioDevice( 0, 0, &desired, mAudioSpec,
+		SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_CHANNELS_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE );
 
-	if(mVal < 0 ) {
+	if( !mDevice ) {
 		cout << "Audio Device Initialization failed: " << SDL_GetError();
 		cout << endl;
 		return false;
 	}
 
+	// Render at the rate the device runs at
+	if( (dword) mAudioSpec->freq != mSampleRate ) {
+		mSampleRate = mAudioSpec->freq;
+		qualityApply( mQuality );
+	}
+
 	return true;
 }
 
 void cSound::playback( bool pStart ) {
 	
-	if( pStart && mVal >= 0 ) {
+	if( pStart && mDevice ) {
 		// Start
-		SDL_PauseAudio(0);
+		SDL_PauseAudioDevice( mDevice, 0 );
 		mFinalCount = 0;
-	} else
+	} else {
 		// Stop
-		SDL_PauseAudio(1);
+		if( mDevice )
+			SDL_PauseAudioDevice( mDevice, 1 );
+
+		// Drop what was rendered for the old music, the device is no longer reading
+		lock();
+		if( mRing )
+			mRing->reset();
 
+		musicCacheStop();
+		unlock();
+	}
+
+}
+
+// FNV-1a, identifies the music file a cache was rendered from (and the benchmark output)
+static dword musicCacheHash( const byte *pBuffer, size_t pSize, dword pHash = 0x811C9DC5 ) {
+	dword hash = pHash;
+
+	for( size_t i = 0; i < pSize; ++i ) {
+		hash ^= pBuffer[i];
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+void cSound::musicCacheStart( string pName, const byte *pSource, size_t pSourceSize ) {
+	musicCacheStop();
+
+	if( !mDevice )
+		return;
+
+	mCacheName = pName + ".pcm";
+	mCacheSourceSize = (dword) pSourceSize;
+	mCacheSourceHash = musicCacheHash( pSource, pSourceSize );
+
+	mCacheMap = local_FileMap( mCacheName, MUSIC_CACHE_PATH, mCacheMapSize, false );
+	if( mCacheMap && mCacheMapSize >= sizeof( sMusicCacheHeader ) ) {
+		sMusicCacheHeader *header = (sMusicCacheHeader*) mCacheMap;
+
+		// Rendered by this version, for this device format and music file, at no lower a quality than it would be now?
+		if( !memcmp( header->mMagic, "CRPM", 4 ) && header->mVersion == MUSIC_CACHE_VERSION &&
+			header->mRate == mSampleRate && header->mChannels == 1 && header->mQuality >= (dword) mQuality &&
+			header->mSourceSize == mCacheSourceSize && header->mSourceHash == mCacheSourceHash &&
+			header->mSamples && mCacheMapSize == sizeof( sMusicCacheHeader ) + (header->mSamples * sizeof( short )) ) {
+
+			mCacheSamples = (const short*) (mCacheMap + sizeof( sMusicCacheHeader ));
+			mCacheCount = header->mSamples;
+			mCachePosition = 0;
+			return;
+		}
+	}
+
+	// Stale or missing, render it live and record the first pass
+	local_FileUnmap( mCacheMap, mCacheMapSize );
+	mCacheMap = 0;
+
+	mCacheCapture.clear();
+	mCacheCapturing = true;
+}
+
+void cSound::musicCacheStop() {
+
+	local_FileUnmap( mCacheMap, mCacheMapSize );
+
+	mCacheMap = 0;
+	mCacheMapSize = 0;
+	mCacheSamples = 0;
+	mCacheCount = mCachePosition = 0;
+
+	mCacheCapturing = false;
+	mCacheCapture.clear();
+}
+
+void cSound::musicCacheEnd() {
+
+	if( !mCacheCapturing )
+		return;
+
+	mCacheCapturing = false;
+
+	if( mCacheCapture.empty() || mCacheComplete )
+		return;
+
+	// Hand the pass over to be written, the next music may start recording straight away
+	memcpy( mCachePendingHeader.mMagic, "CRPM", 4 );
+	mCachePendingHeader.mVersion = MUSIC_CACHE_VERSION;
+	mCachePendingHeader.mRate = mSampleRate;
+	mCachePendingHeader.mChannels = 1;
+	mCachePendingHeader.mSourceSize = mCacheSourceSize;
+	mCachePendingHeader.mSourceHash = mCacheSourceHash;
+	mCachePendingHeader.mQuality = mQuality;
+	mCachePendingHeader.mSamples = (dword) mCacheCapture.size();
+
+	mCachePendingName = mCacheName;
+	mCachePending.swap( mCacheCapture );
+	mCacheCapture.clear();
+
+	mCacheComplete = true;
+}
+
+// Play the mapped music, looping back to the start
+void cSound::musicCacheFill( short *pBuffer, dword pSamples ) {
+
+	while( pSamples ) {
+		dword count = min( pSamples, mCacheCount - mCachePosition );
+
+		memcpy( pBuffer, mCacheSamples + mCachePosition, count * sizeof( short ) );
+
+		pBuffer += count;
+		pSamples -= count;
+
+		mCachePosition += count;
+		if( mCachePosition == mCacheCount )
+			mCachePosition = 0;
+	}
+}
+
+// Runs on the audio thread, only the audio thread touches the pending pass. The pass is
+// moved to the writer thread, so slow storage can not stall rendering
+void cSound::musicCacheSave() {
+	sMusicCacheWrite *write = new sMusicCacheWrite();
+
+	write->mName = mCachePendingName;
+	write->mHeader = mCachePendingHeader;
+	write->mSamples.swap( mCachePending );
+	write->mWriting = &mCacheWriting;
+
+	mCacheComplete = false;
+
+	// The last writer has finished, release its thread
+	musicCacheWait();
+
+	SDL_AtomicSet( &mCacheWriting, 1 );
+	mCacheWriter = SDL_CreateThread( cSound_CacheWriter, "creep music cache", write );
+
+	if( !mCacheWriter )
+		cSound_CacheWriter( write );
+}
+
+// Wait for the cache writer to finish
+void cSound::musicCacheWait() {
+
+	if( !mCacheWriter )
+		return;
+
+	SDL_WaitThread( mCacheWriter, 0 );
+	mCacheWriter = 0;
+}
+
+// Write a little-endian dword
+static void waveDwordWrite( byte *pBuffer, dword pValue ) {
+
+	writeLEWord( pBuffer, pValue & 0xFFFF );
+	writeLEWord( pBuffer + 2, pValue >> 16 );
+}
+
+// Run the sequencer and SID as fast as possible until it finishes, then half a second more for the release of the last notes
+void cSound::sequenceRender( vector< short > &pSamples, dword pSamplesMax ) {
+	short	buffer[ SOUND_RENDER_SAMPLES ];
+	dword	tail = 0;
+
+	while( pSamples.size() < pSamplesMax && tail < mSampleRate / 2 ) {
+
+		// Finished
+		if( !mCreep->musicBufferGet() )
+			tail += SOUND_RENDER_SAMPLES;
+
+		audioBufferFill( buffer, sizeof( buffer ) );
+		pSamples.insert( pSamples.end(), buffer, buffer + SOUND_RENDER_SAMPLES );
+	}
+}
+
+// Save the music/effect being sequenced as a mono WAV, rendered as fast as possible
+bool cSound::waveRender( string pFile, dword pSecondsMax ) {
+	vector< short >	samples;
+
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	sequenceRender( samples, pSecondsMax * mSampleRate );
+
+	double elapsed = (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+	double seconds = (double) samples.size() / mSampleRate;
+
+	// RIFF header, 16 bit mono PCM
+	dword dataSize = samples.size() * sizeof( short );
+	vector< byte > wave( 0x2C + dataSize );
+
+	memcpy( &wave[0x00], "RIFF", 4 );
+	waveDwordWrite( &wave[0x04], 0x24 + dataSize );
+	memcpy( &wave[0x08], "WAVEfmt ", 8 );
+	waveDwordWrite( &wave[0x10], 0x10 );
+	writeLEWord( &wave[0x14], 1 );						// PCM
+	writeLEWord( &wave[0x16], 1 );						// Channels
+	waveDwordWrite( &wave[0x18], mSampleRate );
+	waveDwordWrite( &wave[0x1C], mSampleRate * sizeof( short ) );
+	writeLEWord( &wave[0x20], sizeof( short ) );		// Block align
+	writeLEWord( &wave[0x22], 16 );						// Bits per sample
+	memcpy( &wave[0x24], "data", 4 );
+	waveDwordWrite( &wave[0x28], dataSize );
+
+	for( size_t i = 0; i < samples.size(); ++i )
+		writeLEWord( &wave[ 0x2C + (i * 2) ], samples[i] );
+
+	ofstream file( pFile.c_str(), ios::binary | ios::out );
+	if( !file.is_open() ) {
+		cout << "Unable to write " << pFile << endl;
+		return false;
+	}
+
+	file.write( (char*) &wave[0], wave.size() );
+	file.close();
+
+	cout << "Rendered " << seconds << " seconds in " << (elapsed * 1000) << "ms, ";
+	cout << (elapsed > 0 ? seconds / elapsed : 0) << "x realtime" << endl;
+
+	return true;
+}
+
+// Render the effect being sequenced, without the level the SID sits at when silent, and without the silence after it
+void cSound::effectRender( vector< short > &pSamples ) {
+
+	sequenceRender( pSamples, SOUND_EFFECT_SECONDS * mSampleRate );
+	if( pSamples.empty() )
+		return;
+
+	// The voices have released by the end of the tail, leaving only the SID's DC level
+	int level = pSamples.back();
+
+	for( size_t sample = 0; sample < pSamples.size(); ++sample )
+		pSamples[sample] = (short) max( -0x8000, min( 0x7FFF, pSamples[sample] - level ) );
+
+	while( !pSamples.empty() && abs( pSamples.back() ) <= 1 )
+		pSamples.pop_back();
+}
+
+void cSound::effectBankSet( byte pEffect, vector< short > &pSamples ) {
+
+	mEffects->bankSet( pEffect, pSamples );
+}
+
+void cSound::effectBankReady() {
+
+	mEffects->bankReady();
+}
+
+bool cSound::effectsReady() {
+
+	return mEffects->readyGet();
+}
+
+void cSound::effectPlay( byte pEffect ) {
+
+	mEffects->play( pEffect );
+
+	// The device is paused whenever the music stops
+	if( mDevice )
+		SDL_PauseAudioDevice( mDevice, 0 );
+}
+
+// Clock a fixed test tune through every reSID sampling method, and report the speed of each
+void cSound::sidBenchmark() {
+	static const char *methods[] = { "fast", "interpolate", "resample interpolate", "resample fast" };
+	static const byte tune[][2] = {
+		{ 0x00, 0x25 }, { 0x01, 0x1C }, { 0x05, 0x09 }, { 0x06, 0xF0 }, { 0x04, 0x21 },	// Voice 1, sawtooth
+		{ 0x07, 0x00 }, { 0x08, 0x30 }, { 0x0A, 0x08 }, { 0x0C, 0x0A }, { 0x0D, 0xA0 }, { 0x0B, 0x41 },	// Voice 2, pulse
+		{ 0x0E, 0x33 }, { 0x0F, 0x0B }, { 0x13, 0x11 }, { 0x14, 0x90 }, { 0x12, 0x11 },	// Voice 3, triangle
+		{ 0x15, 0x03 }, { 0x16, 0x40 }, { 0x17, 0xF7 }, { 0x18, 0x1F }						// Filter, volume
+	};
+	const int	seconds = 10;
+	short		buffer[0x1000];
+
+	cout << "SID benchmark: " << seconds << " seconds of PAL output at 22050Hz" << endl;
+
+	for( int method = SAMPLE_FAST; method <= SAMPLE_RESAMPLE_FAST; ++method ) {
+		cSID *sid = new cSID();
+
+		if( !sid->set_sampling_parameters( SOUND_CLOCK_PAL, (sampling_method) method, 22050 ) ) {
+			cout << " " << methods[method] << ": unsupported" << endl;
+			delete sid;
+			continue;
+		}
+
+		sid->reset();
+		sid->enable_filter( true );
+		for( size_t i = 0; i < sizeof( tune ) / sizeof( tune[0] ); ++i )
+			sid->write( tune[i][0], tune[i][1] );
+
+		dword	hash = 0x811C9DC5;
+		dword	samples = 0;
+		Uint64	start = SDL_GetPerformanceCounter();
+
+		for( int second = 0; second < seconds; ++second ) {
+			cycle_count cycles = SOUND_CLOCK_PAL;
+
+			while( cycles ) {
+				int count = sid->clock( cycles, buffer, sizeof( buffer ) / sizeof( short ) );
+
+				hash = musicCacheHash( (const byte*) buffer, count * sizeof( short ), hash );
+				samples += count;
+			}
+		}
+
+		double ms = (double) (SDL_GetPerformanceCounter() - start) * 1000 / SDL_GetPerformanceFrequency();
+
+		cout << " " << methods[method] << ": " << ms << "ms, " << (seconds * 1000) / ms << "x realtime";
+		cout << ", " << samples << " samples, hash " << hex << hash << dec << endl;
+
+		delete sid;
+	}
 }
@@ -24,31 +24,157 @@
  */
 
 class cSID;
+class cAudioRing;
+class cAudioStats;
+class cEffectMixer;
+
+// Samples rendered per pass of audioBufferFill when writing a WAV. With a device, each pass is one device buffer
+#define SOUND_RENDER_SAMPLES	0x800
+
+// Underflows with nothing sequenced (about a second) before the SID is considered silent, and no longer clocked
+#define SOUND_IDLE_TICKS		50
+
+// PAL C64 CPU clock, which drives the SID and the CIA timers
+#define SOUND_CLOCK_PAL			985248
+
+// CIA #1 Timer A latch low byte, left at the KERNAL default ($4025)
+#define SOUND_CIA_LATCH_LO		0x25
+
+// Output rate and device buffer size, unless changed from the command line. The device may
+// negotiate others, the SID then renders at the rate obtained
+#define SOUND_RATE_DEFAULT		44100
+#define SOUND_FRAMES_DEFAULT	512
+#define SOUND_FRAMES_MIN		128
+#define SOUND_FRAMES_MAX		32768			// Largest power of two SDL_AudioSpec::samples can hold
+
+// SID quality levels, stepped at runtime by the time audioBufferFill takes against the time its pass plays for.
+// SAMPLE_RESAMPLE_FAST is not used, building its FIR table takes far longer than a pass
+enum eSoundQuality {
+	eSoundQuality_Fast = 0,			// SAMPLE_FAST, no filter
+	eSoundQuality_Filter,			// SAMPLE_FAST
+	eSoundQuality_Interpolate,		// SAMPLE_INTERPOLATE
+	eSoundQuality_Resample,			// SAMPLE_RESAMPLE_INTERPOLATE
+	eSoundQuality_Max = eSoundQuality_Resample
+};
+
+#define SOUND_QUALITY_LOAD_HIGH		0.50	// Step down when the average pass takes this much of its play time
+#define SOUND_QUALITY_LOAD_PEAK		0.90	// Step down straight away, a pass this slow nearly underran
+#define SOUND_QUALITY_LOAD_LOW		0.10	// Step up when passes stay under this much of their play time...
+#define SOUND_QUALITY_SECONDS_UP	3		// ...for this long, doubled each time a step up fails
+#define SOUND_QUALITY_BACKOFF_MAX	16
+#define SOUND_QUALITY_SECONDS_CALM	30		// Halve the backoff after passes stay under SOUND_QUALITY_LOAD_LOW this long
+
+// Pre-rendered intro music, stored as "cache/MUSICn.pcm" in the data directory
+#define MUSIC_CACHE_PATH		"cache"
+#define MUSIC_CACHE_VERSION		3
+
+struct sMusicCacheHeader {
+	char			 mMagic[4];						// "CRPM"
+	dword			 mVersion;
+	dword			 mRate, mChannels;				// Format the samples were rendered in
+	dword			 mSourceSize, mSourceHash;		// Music file the samples were rendered from
+	dword			 mQuality;						// eSoundQuality the samples were rendered at
+	dword			 mSamples;						// One pass of the music
+};
 
 class cSound {
 
 private:
 	cSID			*mSID;
+	cSID			*mSIDResample;					// Holds the resampling FIR table while the quality can step up to it
 	cCreep			*mCreep;
 
-	SDL_AudioSpec	*mAudioSpec;
-	int				 mVal;
-	int				 mCyclesRemaining;				// Number of cycles before frame update is complete
-	int				 mTicks;						// Number of ticks before CIA timer fires
+	SDL_AudioSpec	*mAudioSpec;					// Obtained device format
+	SDL_AudioDeviceID mDevice;
+	dword			 mSampleRate;					// SID output rate, mono
+	int				 mCiaCycles;					// Cycles until CIA Timer A underflows, and the music interrupt runs
 	int				 mFinalCount;
 
-	bool			 devicePrepare();
+	cAudioStats		*mStats;
+	cEffectMixer	*mEffects;
+	short			 mIdleLevel;					// SID output once it went silent
+	dword			 mCyclesClocked;				// SID cycles clocked by the current render
+
+	cAudioRing		*mRing;							// Samples rendered by the audio thread, waiting for the device
+	short			*mRender;						// Audio thread render buffer
+	dword			 mRenderSize;
+
+	SDL_Thread		*mThread;
+	SDL_mutex		*mLock;							// Held while the sequencer/SID are in use
+	SDL_sem			*mRingSpace;					// Posted by the device after it takes samples, while the producer waits
+	SDL_atomic_t	 mRingWaiting;					// Set while the producer is waiting on mRingSpace
+	SDL_atomic_t	 mThreadRun;
+
+	eSoundQuality	 mQuality;
+	bool			 mQualityFixed;					// Set by the user, no adaptive stepping
+	double			 mQualityLoad;					// Running average of render time / play time
+	dword			 mQualityPasses;				// Passes in a row under SOUND_QUALITY_LOAD_LOW, at this level
+	dword			 mQualityCalm;					// Passes in a row under SOUND_QUALITY_LOAD_LOW, at any level
+	dword			 mQualityBackoff;
+
+	string			 mCacheName;
+	dword			 mCacheSourceSize, mCacheSourceHash;
+	vector< short >	 mCacheCapture;					// First pass of music with no cache yet
+	bool			 mCacheCapturing, mCacheComplete;
+	vector< short >	 mCachePending;					// Completed pass, waiting to be written
+	sMusicCacheHeader mCachePendingHeader;
+	string			 mCachePendingName;
+	SDL_Thread		*mCacheWriter;					// Writes a completed pass, away from the audio thread
+	SDL_atomic_t	 mCacheWriting;
+
+	byte			*mCacheMap;						// Mapped cache file being played
+	size_t			 mCacheMapSize;
+	const short		*mCacheSamples;
+	dword			 mCacheCount, mCachePosition;
+
+	int				 ciaPeriodGet();
+	bool			 devicePrepare( dword pRate, dword pFrames );
+	void			 qualityApply( eSoundQuality pQuality );
+	void			 qualityUpdate( double pLoad );
+	void			 musicCacheFill( short *pBuffer, dword pSamples );
+	void			 musicCacheSave();
+	void			 musicCacheWait();
+	void			 threadStart();
+	void			 threadStop();
 
 public:
 
-	 cSound( cCreep *pCreep );
+	 cSound( cCreep *pCreep, bool pDevice = true, dword pRate = SOUND_RATE_DEFAULT, dword pFrames = SOUND_FRAMES_DEFAULT );
 	~cSound();
 
-	void			 audioBufferFill( short *pBuffer, int pBufferSize );
+	void			 audioBufferFill( short *pBuffer, int pBufferSize );	// Run the sequencer and SID, on the audio thread
+	void			 audioBufferCopy( short *pBuffer, int pBufferSize );	// Hand rendered samples to the device
+	int				 audioThread();
+
 	void			 sidWrite( byte pRegister, byte pValue );
 
+	// The game thread must hold the lock while changing the music/effect being sequenced
+	inline void		 lock()		{ SDL_LockMutex( mLock ); }
+	inline void		 unlock()	{ SDL_UnlockMutex( mLock ); }
+
 	void			 playback( bool pStart );
+
+	void			 qualitySet( eSoundQuality pQuality, bool pFixed );	// Fixed stops the adaptive stepping
+	inline eSoundQuality qualityGet() { return mQuality; }
+
+	void			 musicCacheStart( string pName, const byte *pSource, size_t pSourceSize );	// Play looping music from the cache, or record it
+	void			 musicCacheStop();
+	void			 musicCacheEnd();					// Sequencer reached the end of the first pass
 	
+	void			 sequenceRender( vector< short > &pSamples, dword pSamplesMax );	// Render until the sequencer finishes
+	bool			 waveRender( string pFile, dword pSecondsMax );	// Render the sequencer to a WAV, with no device
+	void			 effectRender( vector< short > &pSamples );		// Render an effect for the bank, centred on zero
+
+	void			 effectBankSet( byte pEffect, vector< short > &pSamples );
+	void			 effectBankReady();
+	bool			 effectsReady();
+	void			 effectPlay( byte pEffect );					// Mix a bank effect over the music
+
+	inline bool		 deviceOpen() { return mDevice != 0; }
+	inline dword	 sampleRateGet() { return mSampleRate; }
+	static void		 sidBenchmark();					// Time each reSID sampling method
+
+	inline cAudioStats *statsGet() { return mStats; }
 	inline cSID		*sidGet() { return mSID; }
 	inline cCreep	*creepGet() { return mCreep; }
 	inline void		 finalCountZero() { 	mFinalCount = 0; }
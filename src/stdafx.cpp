@@ -27,6 +27,7 @@
 #include "creep.h"
 #include "castle/objects/object.hpp"
 #include "builder.hpp"
+#include "diskValidator.h"
 
 const char   *VERSION = "v1.1";
 
@@ -44,6 +45,16 @@ int	main( int argc, char *argv[] ) {
 	SetConsoleCtrlHandler( (PHANDLER_ROUTINE) CtrlHandler, TRUE );
 #endif
 
+	// Check disk images and exit, before the game opens its window or looks for its data
+	for( int count = 0; count + 2 < argc; ++count ) {
+
+		if( string( argv[count] ) == "-v" ) {
+			cDiskValidator validator( local_PathFull( argv[count + 1] ) );
+
+			return validator.run( argv[count + 2] ) ? 0 : 1;
+		}
+	}
+
 #ifndef BUILDER
 	cCreep* gCreep = new cCreep();
 #else
@@ -56,9 +67,22 @@ int	main( int argc, char *argv[] ) {
 	return 0;
 }
 
+// A path from the root, or a drive
+static bool pathIsFull( string pPath ) {
+
+	if( pPath.size() && (pPath[0] == '/' || pPath[0] == '\\') )
+		return true;
+
+	return pPath.size() > 1 && pPath[1] == ':';
+}
+
 string local_PathGenerate( string pFile, string pPath, bool pDataSave ) {
 	stringstream	 filePathFinal;
 
+	// A full path is not inside the data folders
+	if( pathIsFull( pPath ) )
+		return pPath + "/" + pFile;
+
 #ifdef _MACOSX
     filePathFinal << "/Applications/DrCreep/";
 #endif
@@ -145,9 +169,121 @@ byte *local_FileRead( string pFile, string pPath, size_t	&pFileSize, bool pDataS
 	return fileBuffer;
 }
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// Size and modification time of a file, without opening it
+bool local_FileStat( string pFile, string pPath, bool pDataSave, size_t &pFileSize, dword &pTime ) {
+	string finalPath = local_PathGenerate( pFile, pPath, pDataSave );
+	struct stat fileStat;
+
+	if( stat( finalPath.c_str(), &fileStat ) != 0 )
+		return false;
+
+	pFileSize = (size_t) fileStat.st_size;
+	pTime = (dword) fileStat.st_mtime;
+	return true;
+}
+
+// Open a file for positioned reads and writes
+FILE *local_FileOpen( string pFile, string pPath, bool pDataSave, const char *pMode ) {
+	string finalPath = local_PathGenerate( pFile, pPath, pDataSave );
+
+	return fopen( finalPath.c_str(), pMode );
+}
+
+bool local_FileRemove( string pFile, string pPath, bool pDataSave ) {
+	string finalPath = local_PathGenerate( pFile, pPath, pDataSave );
+
+	return remove( finalPath.c_str() ) == 0;
+}
+
+// Does 'pName' end in 'pExtension', ignoring case
+static bool directoryExtensionMatch( string pName, string pExtension ) {
+
+	if( pName.size() < pExtension.size() )
+		return false;
+
+	string end = pName.substr( pName.size() - pExtension.size() );
+
+	transform( end.begin(), end.end(), end.begin(), ::toupper );
+	transform( pExtension.begin(), pExtension.end(), pExtension.begin(), ::toupper );
+
+	return end == pExtension;
+}
+
+static void directoryTreeWalk( string pRoot, string pFolder, string pExtension, vector<string> &pResults );
+
+// Find files ending in 'pExtension' in 'pPath' and all of its sub folders, named relative to 'pPath'
+vector<string> directoryListTree( string pPath, string pExtension, bool pDataSave ) {
+	vector<string> results;
+
+	directoryTreeWalk( local_PathGenerate( "", pPath, pDataSave ), "", pExtension, results );
+
+	sort( results.begin(), results.end() );
+	return results;
+}
+
 // WiN32 Functions
 #ifdef WIN32
 #include <direct.h>
+#include <errno.h>
+#include <io.h>
+
+// Flush a file through to the storage
+bool local_FileSync( FILE *pFile ) {
+
+	if( fflush( pFile ) != 0 )
+		return false;
+
+	return _commit( _fileno( pFile ) ) == 0;
+}
+
+// Map a file read-only into memory, the file is not copied
+byte *local_FileMap( string pFile, string pPath, size_t &pFileSize, bool pDataSave ) {
+	string finalPath = local_PathGenerate( pFile, pPath, pDataSave );
+	byte *buffer = 0;
+
+	HANDLE file = CreateFileA( finalPath.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+	if( file == INVALID_HANDLE_VALUE )
+		return 0;
+
+	pFileSize = (size_t) GetFileSize( file, 0 );
+
+	HANDLE mapping = CreateFileMapping( file, 0, PAGE_READONLY, 0, 0, 0 );
+	if( mapping ) {
+		buffer = (byte*) MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+
+		// The view keeps the mapping open
+		CloseHandle( mapping );
+	}
+
+	CloseHandle( file );
+	return buffer;
+}
+
+void local_FileUnmap( byte *pBuffer, size_t pFileSize ) {
+
+	if( pBuffer )
+		UnmapViewOfFile( pBuffer );
+}
+
+bool local_DirectoryCreate( string pPath, bool pDataSave ) {
+	string finalPath = local_PathGenerate( "", pPath, pDataSave );
+
+	return (_mkdir( finalPath.c_str() ) == 0 || errno == EEXIST);
+}
+
+// A path relative to the working folder, made full so local_PathGenerate uses it as given
+string local_PathFull( string pPath ) {
+	char folder[2000];
+
+	if( pathIsFull( pPath ) || !_getcwd( folder, sizeof( folder ) ) )
+		return pPath;
+
+	return string( folder ) + "/" + pPath;
+}
+
 bool CtrlHandler( dword fdwCtrlType ) {
 	
 	switch( fdwCtrlType ) {
@@ -225,6 +361,30 @@ vector<string> directoryList(string pPath, string pExtension, bool pDataSave) {
 	return results;
 }
 
+static void directoryTreeWalk( string pRoot, string pFolder, string pExtension, vector<string> &pResults ) {
+	WIN32_FIND_DATAA fdata;
+	string search = pRoot + pFolder + "*";
+
+	HANDLE dhandle = FindFirstFileA( search.c_str(), &fdata );
+	if( dhandle == INVALID_HANDLE_VALUE )
+		return;
+
+	do {
+		string name = fdata.cFileName;
+
+		if( name == "." || name == ".." )
+			continue;
+
+		if( fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+			directoryTreeWalk( pRoot, pFolder + name + "/", pExtension, pResults );
+		else if( directoryExtensionMatch( name, pExtension ) )
+			pResults.push_back( pFolder + name );
+
+	} while( FindNextFileA( dhandle, &fdata ) );
+
+	FindClose( dhandle );
+}
+
 // End Win32 Functions
 
 #else
@@ -236,6 +396,68 @@ vector<string> directoryList(string pPath, string pExtension, bool pDataSave) {
 #endif
 
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Flush a file through to the storage
+bool local_FileSync( FILE *pFile ) {
+
+	if( fflush( pFile ) != 0 )
+		return false;
+
+	return fsync( fileno( pFile ) ) == 0;
+}
+
+// Map a file read-only into memory, the file is not copied
+byte *local_FileMap( string pFile, string pPath, size_t &pFileSize, bool pDataSave ) {
+	string finalPath = local_PathGenerate( pFile, pPath, pDataSave );
+	struct stat fileStat;
+
+	int file = open( finalPath.c_str(), O_RDONLY );
+	if( file < 0 )
+		return 0;
+
+	if( fstat( file, &fileStat ) != 0 || fileStat.st_size == 0 ) {
+		close( file );
+		return 0;
+	}
+
+	pFileSize = (size_t) fileStat.st_size;
+
+	void *buffer = mmap( 0, pFileSize, PROT_READ, MAP_SHARED, file, 0 );
+
+	// The mapping stays valid after the descriptor is closed
+	close( file );
+
+	if( buffer == MAP_FAILED )
+		return 0;
+
+	return (byte*) buffer;
+}
+
+void local_FileUnmap( byte *pBuffer, size_t pFileSize ) {
+
+	if( pBuffer )
+		munmap( pBuffer, pFileSize );
+}
+
+bool local_DirectoryCreate( string pPath, bool pDataSave ) {
+	string finalPath = local_PathGenerate( "", pPath, pDataSave );
+
+	return (mkdir( finalPath.c_str(), 0755 ) == 0 || errno == EEXIST);
+}
+
+// A path relative to the working folder, made full so local_PathGenerate uses it as given
+string local_PathFull( string pPath ) {
+	char folder[2000];
+
+	if( pathIsFull( pPath ) || !getcwd( folder, sizeof( folder ) ) )
+		return pPath;
+
+	return string( folder ) + "/" + pPath;
+}
 
 bool CtrlHandler( dword fdwCtrlType ) {
 	
@@ -297,4 +519,30 @@ vector<string> directoryList(string pPath, string pExtension, bool pDataSave) {
 	return results;
 }
 
+static void directoryTreeWalk( string pRoot, string pFolder, string pExtension, vector<string> &pResults ) {
+	DIR *dir = opendir( (pRoot + pFolder).c_str() );
+	struct dirent *entry;
+
+	if( !dir )
+		return;
+
+	while( (entry = readdir( dir )) != 0 ) {
+		string name = entry->d_name;
+		struct stat fileStat;
+
+		if( name == "." || name == ".." )
+			continue;
+
+		if( stat( (pRoot + pFolder + name).c_str(), &fileStat ) != 0 )
+			continue;
+
+		if( S_ISDIR( fileStat.st_mode ) )
+			directoryTreeWalk( pRoot, pFolder + name + "/", pExtension, pResults );
+		else if( directoryExtensionMatch( name, pExtension ) )
+			pResults.push_back( pFolder + name );
+	}
+
+	closedir( dir );
+}
+
 #endif
@@ -33,6 +33,7 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <cstdio>
 #include <map>
 #include <sys/timeb.h>
 
@@ -116,9 +117,19 @@ extern const char *VERSION;
 
 bool CtrlHandler( dword fdwCtrlType );
 vector<string>	 directoryList(string pPath, string pExtension, bool pDataSave);
+vector<string>	 directoryListTree( string pPath, string pExtension, bool pDataSave );
+string			 local_PathGenerate( string pFile, string pPath, bool pDataSave );
+string			 local_PathFull( string pPath );
 byte			*local_FileRead( string pFile, string pPath, size_t	&pFileSize, bool pDataSave );
 bool			 local_FileCreate( string pFile, string pPath, bool pDataSave );
 bool			 local_FileSave( string pFile, string pPath, bool pDataSave, byte *pBuffer, size_t pBufferSize );
+bool			 local_FileStat( string pFile, string pPath, bool pDataSave, size_t &pFileSize, dword &pTime );
+FILE			*local_FileOpen( string pFile, string pPath, bool pDataSave, const char *pMode );
+bool			 local_FileSync( FILE *pFile );
+bool			 local_FileRemove( string pFile, string pPath, bool pDataSave );
+byte			*local_FileMap( string pFile, string pPath, size_t &pFileSize, bool pDataSave );
+void			 local_FileUnmap( byte *pBuffer, size_t pFileSize );
+bool			 local_DirectoryCreate( string pPath, bool pDataSave );
 
 #define g_Window cWindow::GetSingleton()
 #define g_Creep cCreep::GetSingleton()
@@ -34,11 +34,7 @@ const word gWidth = 366, gHeight = 272;
 
 cScreen::cScreen( string pWindowTitle ) {
 
-	for(byte Y = 0; Y < 8; ++Y ) {
-		mSprites[Y] = new cSprite();
-		mSprites[Y]->_multiColor0 = 0x0A;
-		mSprites[Y]->_multiColor1 = 0x0D;
-	}
+	spriteCountSet( 8 );
 
 	mBitmapRedraw		= false;
 	mSpriteRedraw		= false;
@@ -46,6 +42,8 @@ cScreen::cScreen( string pWindowTitle ) {
 	mFPSTotal			= 0;
 	mFPSSeconds			= 0;
 	mFPS				= 0;
+	mFPSFrames			= 0;
+	mFPSTick			= SDL_GetTicks();
 	mWindow				= 0;
 	mWindowTitle		= pWindowTitle;
 
@@ -71,7 +69,7 @@ cScreen::cScreen( string pWindowTitle ) {
 
 cScreen::~cScreen() {
 
-	for(byte Y = 0; Y < 8; ++Y ) 
+	for(size_t Y = 0; Y < mSprites.size(); ++Y ) 
 		delete mSprites[Y];
 
 	delete mSurface;
@@ -221,12 +219,29 @@ void cScreen::blit( cScreenSurface *pSurface, size_t pDestX, size_t pDestY, bool
 }
 
 cSprite *cScreen::spriteGet( byte pCount ) {
-	if(pCount > 7)
+	if(pCount >= mSprites.size())
 		return 0;
 
 	return mSprites[pCount];
 }
 
+// Sprites past the eighth are composited in software, the same as the hardware eight
+void cScreen::spriteCountSet( byte pCount ) {
+
+	while( mSprites.size() > pCount ) {
+		delete mSprites.back();
+		mSprites.pop_back();
+	}
+
+	while( mSprites.size() < pCount ) {
+		cSprite *sprite = new cSprite();
+		sprite->_multiColor0 = 0x0A;
+		sprite->_multiColor1 = 0x0D;
+
+		mSprites.push_back( sprite );
+	}
+}
+
 void cScreen::levelNameSet( string pName ) {
 	mLevelName = pName;
 	windowTitleUpdate();
@@ -278,11 +293,22 @@ void cScreen::refresh() {
 	}
 	
 	mWindow->FrameEnd();
+
+	// Frame timers, updated once a second
+	++mFPSFrames;
+	if( SDL_GetTicks() - mFPSTick >= 1000 ) {
+		mFPS = mFPSFrames;
+		mFPSTotal += mFPSFrames;
+		++mFPSSeconds;
+
+		mFPSFrames = 0;
+		mFPSTick = SDL_GetTicks();
+	}
 }
 
 void cScreen::spriteDisable() {
 
-	for( signed char Y = 7; Y >= 0; --Y )
+	for( int Y = (int) mSprites.size() - 1; Y >= 0; --Y )
 		mSprites[Y]->_rEnabled = false;
 }
 
@@ -290,8 +316,8 @@ void cScreen::spriteDraw() {
 	cSprite *sprite;
 	mCollisions.clear();
 
-	// Draw from sprite 7
-	for( signed char Y = 7; Y >= 0; --Y ) {
+	// Draw from the last sprite
+	for( int Y = (int) mSprites.size() - 1; Y >= 0; --Y ) {
 		sprite = mSprites[Y];
 
 		if(!sprite->_rEnabled)
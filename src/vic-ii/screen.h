@@ -33,6 +33,7 @@ struct sScreenPiece;
 class cScreen {
 	byte					 *mBitmapBuffer, *mBitmapColorData, *mBitmapColorRam, mBitmapBackgroundColor;
 	dword					  mFPS, mFPSTotal, mFPSSeconds;
+	dword					  mFPSFrames, mFPSTick;
 
 	cWindow					*mWindow;
 	cBitmapMulticolor		*mBitmap;
@@ -41,7 +42,7 @@ class cScreen {
 	SDL_Surface				*mSDLCursorSurface;
 
 	vector< sScreenPiece* >  mCollisions;
-	cSprite					*mSprites[8];
+	vector< cSprite* >		 mSprites;
 
 	bool					 mBitmapRedraw, mSpriteRedraw, mTextRedraw;
 	size_t					 mScale, mDrawDestX, mDrawDestY, mDrawSrcX, mDrawSrcY;
@@ -76,6 +77,7 @@ public:
 	void					 spriteDisable();
 	void					 spriteDraw();
 	cSprite					*spriteGet( byte pCount );
+	void					 spriteCountSet( byte pCount );		// Number of sprites multiplexed onto the screen
 	
 	void					 levelNameSet( string pName );
 	inline string			 levelNameGet() { return mLevelName; }